@@ -0,0 +1,90 @@
+#include "../DistributedRowWiseMatrix.h"
+#include "../HaloTransport.h"
+#include "../SparseRowWiseMatrix.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// SpMV with the 5-point Laplacian of a grid distributed over 1, 2, 4, ... processes on this machine.
+// Usage: ComparisonDistributed [grid side] [max processes] [iterations]
+// Prints: processes;microseconds per SpMV (slowest rank);largest halo of a rank
+int main(int argc, char** argv) {
+    unsigned int side = argc > 1 ? std::stoi(argv[1]) : 1000;
+    unsigned int maxRanks = argc > 2 ? std::stoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    unsigned int iterations = argc > 3 ? std::stoi(argv[3]) : 20;
+
+    unsigned int size = side * side;
+    std::vector<Barta::Triplet<double>> triplets;
+    triplets.reserve(5 * size);
+    for (unsigned int y = 0; y < side; y++) {
+        for (unsigned int x = 0; x < side; x++) {
+            unsigned int row = y * side + x;
+            triplets.emplace_back(row, row, 4.);
+            if (x > 0) {
+                triplets.emplace_back(row, row - 1, -1.);
+            }
+
+            if (x + 1 < side) {
+                triplets.emplace_back(row, row + 1, -1.);
+            }
+
+            if (y > 0) {
+                triplets.emplace_back(row, row - side, -1.);
+            }
+
+            if (y + 1 < side) {
+                triplets.emplace_back(row, row + side, -1.);
+            }
+        }
+    }
+
+    Barta::SparseRowWiseMatrix<double> A(size, size, std::move(triplets));
+    std::vector<double> v(size);
+    for (unsigned int i = 0; i < size; i++) {
+        v[i] = i % 7;
+    }
+
+    auto expected = A * v;
+
+    for (unsigned int ranks = 1; ranks <= maxRanks; ranks *= 2) {
+        Barta::SharedMemoryTransport transport(ranks, Barta::DistributedRowWiseMatrix<double>::haloCapacities(A, ranks));
+        transport.run([&A, &v, &expected, iterations] (Barta::HaloTransport& transport) {
+            Barta::DistributedRowWiseMatrix<double> distributed(A, transport);
+            std::vector<double> ownedV(v.begin() + distributed.rowBeg, v.begin() + distributed.rowEnd);
+
+            auto result = distributed.multiply(ownedV);
+            for (unsigned int row = 0; row < distributed.ownedRows(); row++) {
+                if (result[row] != expected[distributed.rowBeg + row]) {
+                    throw std::runtime_error("distributed SpMV differs from the sequential one!");
+                }
+            }
+
+            auto beg = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < iterations; i++) {
+                result = distributed.multiply(ownedV);
+            }
+
+            double stats[2] = {
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - beg).count() / iterations,
+                static_cast<double>(distributed.ghostColumns.size())
+            };
+            if (transport.rank() != 0) {
+                transport.send(0, stats, sizeof(stats));
+
+                return;
+            }
+
+            for (unsigned int q = 1; q < transport.size(); q++) {
+                double other[2];
+                transport.receive(q, other, sizeof(other));
+                stats[0] = std::max(stats[0], other[0]);
+                stats[1] = std::max(stats[1], other[1]);
+            }
+
+            std::cout << transport.size() << ";" << stats[0] << ";" << stats[1] << std::endl;
+        });
+    }
+
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "../DenseMatrix.h"
+#include "../NumaRowWiseMatrix.h"
 #include "../SparseRowWiseMatrix.h"
+#include <cassert>
 #include <chrono>
 #include <cmath>
 #include <fstream>
@@ -60,5 +62,48 @@ int main() {
     std::cout << "Parallel row wise product multiplication: ";
     std::cout << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beg).count() << std::endl;
 
+    auto topology = Barta::NumaTopology::detect();
+    Barta::NumaRowWiseMatrix<float> numaA(A, thread_count, topology);
+
+    beg = std::chrono::steady_clock::now();
+    auto B6 = numaA.multiplyRowWise(A, initial_queue_space);
+    std::cout << "NUMA placed parallel row wise product multiplication: ";
+    std::cout << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beg).count() << std::endl;
+    assert(B6 == B5);
+
+    // the first product warms up the caches and the TLB, the fastest of the following ones is reported;
+    // the bytes are those of the matrix arrays and the result, without the gathers of x (see WorkerStats)
+    constexpr int spmvRuns = 5;
+    std::vector<float> x(A.width, 1.f);
+    std::vector<Barta::NumaRowWiseMatrix<float>::WorkerStats> stats;
+    auto numaX = numaA.multiply(x, &stats);
+    assert(numaX == A.multiply<Barta::PlusTimes<float>>(x));
+    std::vector<double> bestSeconds(topology.nodeCount, 0.);
+    std::vector<size_t> nodeBytes(topology.nodeCount, 0);
+    for (int run = 0; run < spmvRuns; run++) {
+        numaA.multiply(x, &stats);
+        for (int node = 0; node < topology.nodeCount; node++) {
+            size_t bytes = 0;
+            double seconds = 0.;
+            for (const auto& workerStats: stats) {
+                if (workerStats.cpu.node == node) {
+                    bytes += workerStats.bytes;
+                    seconds = std::max(seconds, workerStats.seconds);
+                }
+            }
+
+            nodeBytes[node] = bytes;
+            if (run == 0 || seconds < bestSeconds[node]) {
+                bestSeconds[node] = seconds;
+            }
+        }
+    }
+
+    for (int node = 0; node < topology.nodeCount; node++) {
+        if (nodeBytes[node] > 0) {
+            std::cout << "NUMA node " << node << " SpMV bandwidth [GB/s]: " << nodeBytes[node] / bestSeconds[node] / 1e9 << std::endl;
+        }
+    }
+
     return 0;
 }
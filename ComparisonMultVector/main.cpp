@@ -1,4 +1,5 @@
 #include <chrono>
+#include "../CompressedSparseRowWiseMatrix.h"
 #include "../SparseRowWiseMatrix.h"
 #include "../DenseMatrix.h"
 
@@ -47,10 +48,17 @@ int main() {
 
         beg = std::chrono::steady_clock::now();
         auto sparseV = sparseA*w;
-        std::cout << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beg).count();
+        std::cout << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beg).count()  << ";";
+
+        auto compressedA = Barta::CompressedSparseRowWiseMatrix<int>(sparseA);
+        beg = std::chrono::steady_clock::now();
+        auto compressedV = compressedA*w;
+        std::cout << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beg).count()  << ";";
+        std::cout << compressedA.compressionRatio();
 
         for (int i = 0; i < matrixSize; i++) {
             assert(denseV[i] == sparseV[i]);
+            assert(sparseV[i] == compressedV[i]);
         }
 
         std::cout << std::endl;
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "Pruning.h"
+#include "SparseRowWiseMatrix.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+// Row-wise matrix with delta-encoded column indices. Within a row every column is stored as the difference
+// to the previous one (the first one to 0) in a variable-length code:
+//   0xxxxxxx                      delta < 2^7
+//   10xxxxxx xxxxxxxx             delta < 2^14
+//   11000000 + 4 raw bytes        escape for any larger delta
+// The kernels decode the indices on the fly, trading a few instructions for fewer streamed bytes.
+// Rows are contiguous in the byte stream, so a byte offset is kept only for every rowsPerByteOffset-th row;
+// the kernels split the rows into blocks starting at those rows and decode each block sequentially.
+template<NumericType T>
+class CompressedSparseRowWiseMatrix {
+public:
+    using VectorType = std::vector<T>;
+    using TripletType = Triplet<T>;
+    using GeneralType = SparseRowWiseMatrix<T>;
+
+    unsigned int width;
+    unsigned int height;
+
+    std::vector<T> values;
+    std::vector<std::uint8_t> encodedColumns;
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> byteOffsets; // byte position of the rows 0, rowsPerByteOffset, 2 * rowsPerByteOffset, ...
+
+    static constexpr unsigned int rowsPerByteOffset = 256;
+
+    explicit CompressedSparseRowWiseMatrix(
+        const GeneralType& matrix
+    ):
+        width(matrix.width),
+        height(matrix.height),
+        values(matrix.values),
+        offsets(matrix.getOffsets()),
+        byteOffsets(1, 0) {
+        const auto& columnIndices = matrix.getColumnIndices();
+        this->encodedColumns.reserve(columnIndices.size());
+        for (unsigned int row = 0; row < this->height; row++) {
+            if (row > 0 && row % rowsPerByteOffset == 0) {
+                this->byteOffsets.push_back(this->encodedColumns.size());
+            }
+
+            unsigned int previous = 0;
+            for (auto i = this->offsets[row]; i < this->offsets[row + 1]; i++) {
+                CompressedSparseRowWiseMatrix::encode(columnIndices[i] - previous, this->encodedColumns);
+                previous = columnIndices[i];
+            }
+
+            if (this->encodedColumns.size() > std::numeric_limits<unsigned int>::max()) {
+                throw std::runtime_error("encoded column indices do not fit unsigned int offsets!");
+            }
+        }
+
+        this->byteOffsets.push_back(this->encodedColumns.size());
+    }
+
+    GeneralType toGeneral() const {
+        std::vector<TripletType> triplets;
+        triplets.reserve(this->values.size());
+        const std::uint8_t* encoded = this->encodedColumns.data();
+        for (unsigned int row = 0; row < this->height; row++) {
+            unsigned int col = 0;
+            for (auto i = this->offsets[row]; i < this->offsets[row + 1]; i++) {
+                col += CompressedSparseRowWiseMatrix::decode(encoded);
+                triplets.emplace_back(row, col, this->values[i]);
+            }
+        }
+
+        return GeneralType(this->width, this->height, std::move(triplets), true, true);
+    }
+
+    // bytes streamed by SpMV over plain CSR divided by the bytes streamed over this matrix;
+    // the compressed format pays off for bandwidth-bound kernels when it is noticeably above 1
+    double compressionRatio() const {
+        double valueBytes = this->values.size() * sizeof(T);
+        double plainBytes = valueBytes + this->values.size() * sizeof(unsigned int) + this->offsets.size() * sizeof(unsigned int);
+        double compressedBytes =
+            valueBytes + this->encodedColumns.size() + (this->offsets.size() + this->byteOffsets.size()) * sizeof(unsigned int);
+
+        return plainBytes / compressedBytes;
+    }
+
+    VectorType operator*(
+        const VectorType& v
+    ) const {
+        assert(this->width == v.size());
+
+        auto ret = VectorType(this->height, static_cast<T>(0));
+        this->multiplyRows(v, 0, this->height, ret);
+
+        return ret;
+    }
+
+    VectorType multiply(
+        const VectorType& v,
+        unsigned int thread_num
+    ) const {
+        assert(this->width == v.size());
+
+        auto ret = VectorType(this->height, static_cast<T>(0));
+        auto blocks = this->blockCount();
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([this, &v, &ret, blocks, t, thread_num] () {
+                unsigned int blockBeg = static_cast<unsigned long long>(blocks) * t / thread_num;
+                unsigned int blockEnd = static_cast<unsigned long long>(blocks) * (t + 1) / thread_num;
+                this->multiplyRows(v, this->firstRowOf(blockBeg), this->firstRowOf(blockEnd), ret);
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        return ret;
+    }
+
+    GeneralType multiplyRowWise(
+        const GeneralType& other,
+        const unsigned int initialQueueCapacity,
+        const unsigned int thread_num,
+        const Pruning<T>& pruning = {}
+    ) const {
+        std::vector<std::vector<TripletType>> vectorOfTriplets(this->height);
+        auto otherView = other.view();
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        std::atomic<unsigned int> counter(0);
+        for (unsigned int i = 0; i < thread_num; i++) {
+            threads.emplace_back([this, &otherView, initialQueueCapacity, &pruning, &counter, &vectorOfTriplets] () {
+                std::vector<unsigned int> rowColumns;
+                while (true) {
+                    unsigned int block = counter++;
+                    if (block >= this->blockCount()) {
+                        break;
+                    }
+
+                    const std::uint8_t* encoded = this->encodedColumns.data() + this->byteOffsets[block];
+                    for (auto row_l = this->firstRowOf(block); row_l < this->firstRowOf(block + 1); row_l++) {
+                        auto beg = this->offsets[row_l];
+                        auto rowLength = this->offsets[row_l + 1] - beg;
+                        rowColumns.resize(rowLength);
+                        unsigned int col = 0;
+                        for (unsigned int k = 0; k < rowLength; k++) {
+                            col += CompressedSparseRowWiseMatrix::decode(encoded);
+                            rowColumns[k] = col;
+                        }
+
+                        GeneralType::multiplyRowRowWise(
+                            row_l,
+                            this->values.data() + beg,
+                            rowColumns.data(),
+                            rowLength,
+                            otherView,
+                            initialQueueCapacity,
+                            vectorOfTriplets[row_l],
+                            pruning
+                        );
+                    }
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        return GeneralType(other.width, this->height, std::move(vectorOfTriplets));
+    }
+
+private:
+    unsigned int blockCount() const { return this->byteOffsets.size() - 1; }
+
+    unsigned int firstRowOf(
+        unsigned int block
+    ) const {
+        return std::min<unsigned long long>(static_cast<unsigned long long>(block) * rowsPerByteOffset, this->height);
+    }
+
+    static void encode(
+        unsigned int delta,
+        std::vector<std::uint8_t>& encoded
+    ) {
+        if (delta < 0x80) {
+            encoded.push_back(delta);
+        } else if (delta < 0x4000) {
+            encoded.push_back(0x80 | (delta >> 8));
+            encoded.push_back(delta & 0xFF);
+        } else {
+            encoded.push_back(0xC0);
+            std::uint8_t raw[sizeof(delta)];
+            std::memcpy(raw, &delta, sizeof(delta));
+            encoded.insert(encoded.end(), raw, raw + sizeof(delta));
+        }
+    }
+
+    static unsigned int decode(
+        const std::uint8_t*& encoded
+    ) {
+        unsigned int first = *encoded;
+        if (first < 0x80) {
+            encoded += 1;
+
+            return first;
+        }
+
+        if (first < 0xC0) {
+            unsigned int delta = ((first & 0x3F) << 8) | encoded[1];
+            encoded += 2;
+
+            return delta;
+        }
+
+        unsigned int delta;
+        std::memcpy(&delta, encoded + 1, sizeof(delta));
+        encoded += 1 + sizeof(delta);
+
+        return delta;
+    }
+
+    // rowBeg has to be the first row of a block (or the height)
+    void multiplyRows(
+        const VectorType& v,
+        unsigned int rowBeg,
+        unsigned int rowEnd,
+        VectorType& ret
+    ) const {
+        if (rowBeg >= rowEnd) {
+            return;
+        }
+
+        const std::uint8_t* encoded = this->encodedColumns.data() + this->byteOffsets[rowBeg / rowsPerByteOffset];
+        for (auto row = rowBeg; row < rowEnd; row++) {
+            unsigned int col = 0;
+            T value = static_cast<T>(0);
+            for (auto i = this->offsets[row]; i < this->offsets[row + 1]; i++) {
+                col += CompressedSparseRowWiseMatrix::decode(encoded);
+                value += this->values[i] * v[col];
+            }
+
+            ret[row] = value;
+        }
+    }
+};
+}
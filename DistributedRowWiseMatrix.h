@@ -0,0 +1,252 @@
+#pragma once
+
+#include "HaloTransport.h"
+#include "NumericTypeConcept.h"
+#include "Semiring.h"
+#include "SparseRowWiseMatrix.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+namespace Barta {
+
+// One rank's share of a square matrix distributed by blocks of rows. The vector is distributed like the rows,
+// so the owned rows are split into a local block (the columns of the owned vector entries, renumbered from 0)
+// and a remote block whose columns are the ghost entries owned by other ranks, numbered in ghostColumns order.
+// The ranks agree on which entries each one sends at construction, so an SpMV sends exactly the needed values.
+template<NumericType T>
+class DistributedRowWiseMatrix {
+public:
+    using VectorType = std::vector<T>;
+    using TripletType = Triplet<T>;
+    using MatrixType = SparseRowWiseMatrix<T>;
+
+    unsigned int width;
+    unsigned int height;
+    std::vector<unsigned int> rowBlocks; // rows of rank q: [rowBlocks[q], rowBlocks[q + 1])
+    unsigned int rowBeg;
+    unsigned int rowEnd;
+
+    MatrixType localBlock;
+    MatrixType remoteBlock;
+    std::vector<unsigned int> ghostColumns; // global indices, sorted, hence grouped by the owning rank
+    std::vector<unsigned int> ghostOffsets; // ghosts of rank q: [ghostOffsets[q], ghostOffsets[q + 1])
+    std::vector<unsigned int> sendIndices;  // owned entries sent to rank q: [sendOffsets[q], sendOffsets[q + 1])
+    std::vector<unsigned int> sendOffsets;
+
+    // Every rank passes the whole matrix and keeps its rows; the rows are split to balance the nonzeros.
+    // All the ranks of the transport have to construct their part at the same time.
+    DistributedRowWiseMatrix(
+        const MatrixType& matrix,
+        HaloTransport& transport
+    ):
+        width(matrix.width),
+        height(matrix.height),
+        rowBlocks(matrix.getPattern()->balancedRowBlocks(transport.size())),
+        rowBeg(this->rowBlocks[transport.rank()]),
+        rowEnd(this->rowBlocks[transport.rank() + 1]),
+        localBlock(0, 0),
+        remoteBlock(0, 0),
+        transport(transport) {
+        if (matrix.width != matrix.height) {
+            throw std::runtime_error("distributed matrix has to be square!");
+        }
+
+        const auto& offsets = matrix.getOffsets();
+        const auto& columnIndices = matrix.getColumnIndices();
+        for (auto i = offsets[this->rowBeg]; i < offsets[this->rowEnd]; i++) {
+            if (!this->isOwned(columnIndices[i])) {
+                this->ghostColumns.push_back(columnIndices[i]);
+            }
+        }
+
+        std::sort(this->ghostColumns.begin(), this->ghostColumns.end());
+        this->ghostColumns.erase(std::unique(this->ghostColumns.begin(), this->ghostColumns.end()), this->ghostColumns.end());
+
+        std::vector<TripletType> localTriplets;
+        std::vector<TripletType> remoteTriplets;
+        for (auto row = this->rowBeg; row < this->rowEnd; row++) {
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                auto col = columnIndices[i];
+                if (this->isOwned(col)) {
+                    localTriplets.emplace_back(row - this->rowBeg, col - this->rowBeg, matrix.values[i]);
+                } else {
+                    unsigned int ghost = std::lower_bound(this->ghostColumns.begin(), this->ghostColumns.end(), col) - this->ghostColumns.begin();
+                    remoteTriplets.emplace_back(row - this->rowBeg, ghost, matrix.values[i]);
+                }
+            }
+        }
+
+        auto ownedRows = this->rowEnd - this->rowBeg;
+        this->localBlock = MatrixType(ownedRows, ownedRows, std::move(localTriplets), true, true);
+        this->remoteBlock = MatrixType(this->ghostColumns.size(), ownedRows, std::move(remoteTriplets), true, true);
+
+        auto ranks = transport.size();
+        this->ghostOffsets.resize(ranks + 1);
+        for (unsigned int q = 0; q <= ranks; q++) {
+            this->ghostOffsets[q] = std::lower_bound(this->ghostColumns.begin(), this->ghostColumns.end(), this->rowBlocks[q]) - this->ghostColumns.begin();
+        }
+
+        this->agreeOnHalo();
+    }
+
+    // Mailbox capacities for a SharedMemoryTransport of `ranks` ranks (indexed by from * ranks + to) such that the
+    // halo of every pair moves in one chunk, both the ghost values of an SpMV and the indices sent at construction.
+    static std::vector<size_t> haloCapacities(
+        const MatrixType& matrix,
+        unsigned int ranks
+    ) {
+        auto rowBlocks = matrix.getPattern()->balancedRowBlocks(ranks);
+        const auto& offsets = matrix.getOffsets();
+        const auto& columnIndices = matrix.getColumnIndices();
+
+        std::vector<size_t> capacities(static_cast<size_t>(ranks) * ranks, 0);
+        std::vector<unsigned int> lastNeededBy(matrix.width, ranks); // rank whose rows last touched the column
+        std::vector<unsigned int> ownerOf(matrix.width);
+        for (unsigned int q = 0; q < ranks; q++) {
+            std::fill(ownerOf.begin() + rowBlocks[q], ownerOf.begin() + rowBlocks[q + 1], q);
+        }
+
+        for (unsigned int p = 0; p < ranks; p++) {
+            std::vector<size_t> ghosts(ranks, 0);
+            for (auto i = offsets[rowBlocks[p]]; i < offsets[rowBlocks[p + 1]]; i++) {
+                auto col = columnIndices[i];
+                if (ownerOf[col] != p && lastNeededBy[col] != p) {
+                    lastNeededBy[col] = p;
+                    ghosts[ownerOf[col]]++;
+                }
+            }
+
+            for (unsigned int q = 0; q < ranks; q++) {
+                // q sends the ghost values to p, p sends its count and the ghost indices to q
+                auto& values = capacities[static_cast<size_t>(q) * ranks + p];
+                auto& indices = capacities[static_cast<size_t>(p) * ranks + q];
+                values = std::max(values, ghosts[q] * sizeof(T));
+                indices = std::max(indices, (ghosts[q] + 1) * sizeof(unsigned int));
+            }
+        }
+
+        return capacities;
+    }
+
+    unsigned int ownedRows() const { return this->rowEnd - this->rowBeg; }
+
+    // Product of the owned rows with the distributed vector, v being its owned part.
+    // The halo is sent before the local block is multiplied and received afterwards. The local SpMV calls
+    // transport.progress() every progressRows rows, so a halo larger than a mailbox keeps moving in chunks
+    // meanwhile and only the remote block waits for the rest of it.
+    VectorType multiply(
+        const VectorType& v
+    ) const {
+        assert(v.size() == this->ownedRows());
+
+        auto ranks = this->transport.size();
+        VectorType sendBuffer(this->sendIndices.size());
+        for (unsigned int i = 0; i < this->sendIndices.size(); i++) {
+            sendBuffer[i] = v[this->sendIndices[i]];
+        }
+
+        for (unsigned int q = 0; q < ranks; q++) {
+            if (this->sendOffsets[q + 1] > this->sendOffsets[q]) {
+                this->transport.send(q, sendBuffer.data() + this->sendOffsets[q], (this->sendOffsets[q + 1] - this->sendOffsets[q]) * sizeof(T));
+            }
+        }
+
+        VectorType ret(this->ownedRows());
+        const auto& localOffsets = this->localBlock.getOffsets();
+        const auto& localColumnIndices = this->localBlock.getColumnIndices();
+        for (unsigned int row = 0; row < this->ownedRows(); row++) {
+            if (row % progressRows == 0) {
+                this->transport.progress();
+            }
+
+            T value = static_cast<T>(0);
+            for (auto i = localOffsets[row]; i < localOffsets[row + 1]; i++) {
+                value += this->localBlock.values[i] * v[localColumnIndices[i]];
+            }
+
+            ret[row] = value;
+        }
+
+        VectorType ghosts(this->ghostColumns.size());
+        for (unsigned int q = 0; q < ranks; q++) {
+            if (this->ghostOffsets[q + 1] > this->ghostOffsets[q]) {
+                this->transport.receive(q, ghosts.data() + this->ghostOffsets[q], (this->ghostOffsets[q + 1] - this->ghostOffsets[q]) * sizeof(T));
+            }
+        }
+
+        const auto& offsets = this->remoteBlock.getOffsets();
+        const auto& columnIndices = this->remoteBlock.getColumnIndices();
+        for (unsigned int row = 0; row < this->ownedRows(); row++) {
+            T value = static_cast<T>(0);
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                value += this->remoteBlock.values[i] * ghosts[columnIndices[i]];
+            }
+
+            ret[row] += value;
+        }
+
+        return ret;
+    }
+
+private:
+    static constexpr unsigned int progressRows = 1024;
+
+    HaloTransport& transport;
+
+    bool isOwned(
+        unsigned int col
+    ) const {
+        return this->rowBeg <= col && col < this->rowEnd;
+    }
+
+    // Every rank tells the owners which of their entries it needs: first the counts, then the global indices.
+    void agreeOnHalo() {
+        auto ranks = this->transport.size();
+        auto rank = this->transport.rank();
+        for (unsigned int q = 0; q < ranks; q++) {
+            if (q != rank) {
+                unsigned int count = this->ghostOffsets[q + 1] - this->ghostOffsets[q];
+                this->transport.send(q, &count, sizeof(count));
+            }
+        }
+
+        this->sendOffsets.assign(ranks + 1, 0);
+        for (unsigned int q = 0; q < ranks; q++) {
+            unsigned int count = 0;
+            if (q != rank) {
+                this->transport.receive(q, &count, sizeof(count));
+            }
+
+            this->sendOffsets[q + 1] = this->sendOffsets[q] + count;
+        }
+
+        for (unsigned int q = 0; q < ranks; q++) {
+            if (this->ghostOffsets[q + 1] > this->ghostOffsets[q]) {
+                this->transport.send(
+                    q,
+                    this->ghostColumns.data() + this->ghostOffsets[q],
+                    (this->ghostOffsets[q + 1] - this->ghostOffsets[q]) * sizeof(unsigned int)
+                );
+            }
+        }
+
+        this->sendIndices.resize(this->sendOffsets[ranks]);
+        for (unsigned int q = 0; q < ranks; q++) {
+            if (this->sendOffsets[q + 1] > this->sendOffsets[q]) {
+                this->transport.receive(
+                    q,
+                    this->sendIndices.data() + this->sendOffsets[q],
+                    (this->sendOffsets[q + 1] - this->sendOffsets[q]) * sizeof(unsigned int)
+                );
+            }
+        }
+
+        for (auto& index: this->sendIndices) {
+            index -= this->rowBeg;
+        }
+    }
+};
+}
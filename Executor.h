@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+// Pool of worker threads shared by asynchronous kernels. A job is split into chunks and the workers take
+// one chunk at a time from the active jobs in turns, so concurrent jobs share the cores fairly
+// instead of every product spawning its own set of threads.
+class Executor {
+    struct Job {
+        unsigned int chunkCount;
+        unsigned int nextChunk;
+        std::atomic<unsigned int> remaining;
+        std::function<void(unsigned int)> runChunk;
+        std::function<void(std::exception_ptr)> finish;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::shared_ptr<Job>> jobs;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+public:
+    explicit Executor(
+        unsigned int thread_num = std::max(1u, std::thread::hardware_concurrency())
+    ) {
+        this->workers.reserve(thread_num);
+        for (unsigned int i = 0; i < thread_num; i++) {
+            this->workers.emplace_back([this] () { this->work(); });
+        }
+    }
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    ~Executor() {
+        {
+            std::lock_guard lock(this->mutex);
+            this->stopping = true;
+        }
+
+        this->condition.notify_all();
+        for (auto& worker: this->workers) {
+            worker.join();
+        }
+    }
+
+    static Executor& shared() {
+        static Executor executor;
+
+        return executor;
+    }
+
+    unsigned int size() const { return this->workers.size(); }
+
+    // runChunk is called once for every chunk in [0, chunkCount), possibly concurrently.
+    // finish is called once after the last chunk, with the first exception thrown by a chunk (if any).
+    void submit(
+        unsigned int chunkCount,
+        std::function<void(unsigned int)> runChunk,
+        std::function<void(std::exception_ptr)> finish
+    ) {
+        if (chunkCount == 0) {
+            finish(nullptr);
+
+            return;
+        }
+
+        auto job = std::make_shared<Job>();
+        job->chunkCount = chunkCount;
+        job->nextChunk = 0;
+        job->remaining = chunkCount;
+        job->runChunk = std::move(runChunk);
+        job->finish = std::move(finish);
+        {
+            std::lock_guard lock(this->mutex);
+            this->jobs.push_back(std::move(job));
+        }
+
+        this->condition.notify_all();
+    }
+
+    // as above, the value returned by assemble fulfills the future
+    template<typename R>
+    std::future<R> submit(
+        unsigned int chunkCount,
+        std::function<void(unsigned int)> runChunk,
+        std::function<R()> assemble
+    ) {
+        auto promise = std::make_shared<std::promise<R>>();
+        auto future = promise->get_future();
+        this->submit(chunkCount, std::move(runChunk), [promise, assemble = std::move(assemble)] (std::exception_ptr error) {
+            if (error != nullptr) {
+                promise->set_exception(error);
+
+                return;
+            }
+
+            try {
+                promise->set_value(assemble());
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+
+        return future;
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::shared_ptr<Job> job;
+            unsigned int chunk;
+            {
+                std::unique_lock lock(this->mutex);
+                this->condition.wait(lock, [this] () { return this->stopping || !this->jobs.empty(); });
+                if (this->jobs.empty()) {
+                    return;
+                }
+
+                // round robin: the job goes to the back of the queue after giving away a chunk
+                job = std::move(this->jobs.front());
+                this->jobs.pop_front();
+                chunk = job->nextChunk++;
+                if (job->nextChunk < job->chunkCount) {
+                    this->jobs.push_back(job);
+                }
+            }
+
+            try {
+                job->runChunk(chunk);
+            } catch (...) {
+                std::lock_guard lock(job->errorMutex);
+                if (job->error == nullptr) {
+                    job->error = std::current_exception();
+                }
+            }
+
+            if (--job->remaining == 0) {
+                job->finish(job->error);
+            }
+        }
+    }
+};
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Barta {
+
+// Point-to-point messages of any size between the ranks of a distributed matrix. Every exchange is a round in
+// which a rank first sends to all its peers and then receives from them: send() must return without waiting for
+// the receiver, receive() blocks until the message arrives. Messages between two ranks arrive in the order they
+// were sent. progress() moves pending data without blocking; long computations between sends and receives call
+// it now and then. flush() blocks until every message sent by the rank was handed over.
+class HaloTransport {
+public:
+    virtual ~HaloTransport() = default;
+
+    virtual unsigned int rank() const = 0;
+
+    virtual unsigned int size() const = 0;
+
+    virtual void send(
+        unsigned int to,
+        const void* data,
+        size_t bytes
+    ) = 0;
+
+    virtual void receive(
+        unsigned int from,
+        void* data,
+        size_t bytes
+    ) = 0;
+
+    virtual void progress() {}
+
+    virtual void flush() {}
+};
+
+// Transport between processes forked from one parent. Every ordered pair of ranks has a mailbox in an anonymous
+// shared mapping, with a full flag, the length of its chunk and room for capacity bytes. Every rank has one
+// doorbell pipe, rung when one of its incoming mailboxes was filled or one of its outgoing mailboxes was emptied,
+// so the transport needs 2 descriptors per rank and every rank keeps only its own read end.
+// The messages to a rank form one byte stream moved through the mailbox in chunks: send() queues the message
+// and writes a chunk if the mailbox is empty, every later call of the transport moves the next chunks in both
+// directions, and the received bytes are buffered until receive() asks for them. So messages of any size pass,
+// and a rank never waits for a peer that waits for it. Mailboxes sized to the halo (see
+// DistributedRowWiseMatrix::haloCapacities) carry a halo in one chunk, handed over already by send().
+// The transport has to be created before the processes are forked (see run()).
+class SharedMemoryTransport: public HaloTransport {
+public:
+    // every mailbox holds capacity bytes
+    SharedMemoryTransport(
+        unsigned int size,
+        size_t capacity = 1 << 16
+    ):
+        SharedMemoryTransport(size, std::vector<size_t>(static_cast<size_t>(size) * size, capacity)) {}
+
+    // the mailbox from -> to holds capacities[from * size + to] bytes (at least minimumCapacity)
+    SharedMemoryTransport(
+        unsigned int size,
+        const std::vector<size_t>& capacities
+    ):
+        ranks(size),
+        mailboxOffsets(static_cast<size_t>(size) * size + 1, 0),
+        outgoing(size),
+        incoming(size) {
+        if (capacities.size() != static_cast<size_t>(size) * size) {
+            throw std::runtime_error("mailbox capacities do not match the number of rank pairs!");
+        }
+
+        for (size_t pair = 0; pair < capacities.size(); pair++) {
+            auto capacity = std::max(capacities[pair], minimumCapacity);
+            this->mailboxOffsets[pair + 1] = this->mailboxOffsets[pair] + (sizeof(Mailbox) + capacity + cacheLine - 1) / cacheLine * cacheLine;
+        }
+
+        this->mappingBytes = std::max<size_t>(1, this->mailboxOffsets.back());
+        this->mailboxes = mmap(nullptr, this->mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (this->mailboxes == MAP_FAILED) {
+            throw std::runtime_error("cannot map the shared mailboxes!");
+        }
+
+        this->doorbells.resize(2 * static_cast<size_t>(size), -1);
+        for (unsigned int rank = 0; rank < size; rank++) {
+            if (pipe(&this->doorbells[2 * rank]) != 0 || fcntl(this->doorbells[2 * rank], F_SETFL, O_NONBLOCK) != 0) {
+                this->release();
+                throw std::runtime_error("cannot create the transport pipes!");
+            }
+        }
+    }
+
+    SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+    SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+
+    ~SharedMemoryTransport() override { this->release(); }
+
+    unsigned int rank() const override { return this->ownRank; }
+
+    unsigned int size() const override { return this->ranks; }
+
+    void send(
+        unsigned int to,
+        const void* data,
+        size_t bytes
+    ) override {
+        const auto* begin = static_cast<const std::uint8_t*>(data);
+        this->outgoing[to].bytes.insert(this->outgoing[to].bytes.end(), begin, begin + bytes);
+        this->advance(false);
+    }
+
+    void receive(
+        unsigned int from,
+        void* data,
+        size_t bytes
+    ) override {
+        auto& stream = this->incoming[from];
+        while (stream.bytes.size() - stream.consumed < bytes) {
+            this->advance(true);
+        }
+
+        std::memcpy(data, stream.bytes.data() + stream.consumed, bytes);
+        stream.consumed += bytes;
+        stream.compact();
+    }
+
+    void progress() override { this->advance(false); }
+
+    void flush() override {
+        while (std::any_of(this->outgoing.begin(), this->outgoing.end(), [](const Stream& stream) { return !stream.isDone(); })) {
+            this->advance(true);
+        }
+    }
+
+    // Forks one process per rank, runs f(transport) in each of them with the transport bound to the rank and waits
+    // for all of them. When a rank fails the others are killed, since they would wait for its messages forever;
+    // then run() throws. The error of a rank is printed to std::cerr by the rank itself.
+    template<typename F>
+    void run(
+        F f
+    ) {
+        std::cout.flush();
+        std::vector<pid_t> children;
+        for (unsigned int rank = 0; rank < this->ranks; rank++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                break;
+            }
+
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    this->ownRank = rank;
+                    this->closeForeignDoorbells();
+                    f(*this);
+                    this->flush();
+                } catch (const std::exception& e) {
+                    std::cerr << "rank " << rank << ": " << e.what() << std::endl;
+                    status = 1;
+                }
+
+                std::cout.flush();
+                _exit(status);
+            }
+
+            children.push_back(pid);
+        }
+
+        bool failed = children.size() < this->ranks;
+        bool killed = false;
+        while (!children.empty()) {
+            if (failed && !killed) {
+                for (auto pid: children) {
+                    kill(pid, SIGKILL);
+                }
+
+                killed = true;
+            }
+
+            int status;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw std::runtime_error("cannot wait for the ranks of the shared memory transport!");
+            }
+
+            if (std::erase(children, pid) > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+                failed = true;
+            }
+        }
+
+        if (failed) {
+            throw std::runtime_error("a rank of the shared memory transport failed!");
+        }
+    }
+
+private:
+    static constexpr size_t minimumCapacity = 256;
+    static constexpr size_t cacheLine = 64;
+
+    struct Mailbox {
+        std::uint32_t full; // accessed atomically by both processes
+        std::uint32_t padding;
+        std::uint64_t bytes;
+    };
+
+    struct Stream {
+        std::vector<std::uint8_t> bytes;
+        size_t consumed = 0; // bytes already written to the mailbox (outgoing) or returned by receive() (incoming)
+
+        bool isDone() const { return this->consumed == this->bytes.size(); }
+
+        // drops the consumed bytes once they are the larger part, so a stream that never runs empty stays bounded
+        void compact() {
+            if (this->consumed == this->bytes.size()) {
+                this->bytes.clear();
+                this->consumed = 0;
+            } else if (this->consumed > this->bytes.size() / 2) {
+                this->bytes.erase(this->bytes.begin(), this->bytes.begin() + this->consumed);
+                this->consumed = 0;
+            }
+        }
+    };
+
+    unsigned int ranks;
+    unsigned int ownRank = 0;
+    std::vector<size_t> mailboxOffsets; // of every (from, to) pair in the mapping
+    size_t mappingBytes = 0;
+    void* mailboxes = MAP_FAILED;
+    std::vector<int> doorbells; // read and write end of the pipe of every rank
+    std::vector<Stream> outgoing;
+    std::vector<Stream> incoming;
+
+    Mailbox& mailbox(
+        unsigned int from,
+        unsigned int to
+    ) const {
+        return *reinterpret_cast<Mailbox*>(static_cast<std::uint8_t*>(this->mailboxes) + this->mailboxOffsets[static_cast<size_t>(from) * this->ranks + to]);
+    }
+
+    size_t capacityOf(
+        unsigned int from,
+        unsigned int to
+    ) const {
+        auto pair = static_cast<size_t>(from) * this->ranks + to;
+
+        return this->mailboxOffsets[pair + 1] - this->mailboxOffsets[pair] - sizeof(Mailbox);
+    }
+
+    std::uint8_t* payload(
+        Mailbox& mailbox
+    ) const {
+        return reinterpret_cast<std::uint8_t*>(&mailbox) + sizeof(Mailbox);
+    }
+
+    // Empties the full incoming mailboxes and fills the empty outgoing ones with queued bytes, ringing the doorbell
+    // of the peer for each. When nothing moved and wait is set, sleeps until the own doorbell rings. The doorbell
+    // is drained before the mailboxes are checked, so a change after the check always wakes the rank.
+    void advance(
+        bool wait
+    ) {
+        auto ownDoorbell = this->doorbells[2 * this->ownRank];
+        char drained[64];
+        while (read(ownDoorbell, drained, sizeof(drained)) > 0) {
+        }
+
+        bool moved = false;
+        for (unsigned int q = 0; q < this->ranks; q++) {
+            auto& in = this->mailbox(q, this->ownRank);
+            if (std::atomic_ref<std::uint32_t>(in.full).load(std::memory_order_acquire) != 0) {
+                auto& stream = this->incoming[q];
+                stream.bytes.insert(stream.bytes.end(), this->payload(in), this->payload(in) + in.bytes);
+                std::atomic_ref<std::uint32_t>(in.full).store(0, std::memory_order_release);
+                this->ring(q);
+                moved = true;
+            }
+
+            auto& stream = this->outgoing[q];
+            auto& out = this->mailbox(this->ownRank, q);
+            if (!stream.isDone() && std::atomic_ref<std::uint32_t>(out.full).load(std::memory_order_acquire) == 0) {
+                size_t chunk = std::min(this->capacityOf(this->ownRank, q), stream.bytes.size() - stream.consumed);
+                std::memcpy(this->payload(out), stream.bytes.data() + stream.consumed, chunk);
+                out.bytes = chunk;
+                std::atomic_ref<std::uint32_t>(out.full).store(1, std::memory_order_release);
+                this->ring(q);
+                stream.consumed += chunk;
+                stream.compact();
+                moved = true;
+            }
+        }
+
+        if (!wait || moved) {
+            return;
+        }
+
+        pollfd fd = {ownDoorbell, POLLIN, 0};
+        while (poll(&fd, 1, -1) < 0) {
+            if (errno != EINTR) {
+                throw std::runtime_error("cannot poll the transport doorbell!");
+            }
+        }
+    }
+
+    void ring(
+        unsigned int rank
+    ) {
+        char byte = 0;
+        while (write(this->doorbells[2 * rank + 1], &byte, 1) != 1) {
+            if (errno != EINTR) {
+                throw std::runtime_error("cannot write to a transport pipe: " + std::string(std::strerror(errno)) + "!");
+            }
+        }
+    }
+
+    // in a forked rank, the read ends of the other ranks' doorbells are never used
+    void closeForeignDoorbells() {
+        for (unsigned int rank = 0; rank < this->ranks; rank++) {
+            if (rank != this->ownRank && this->doorbells[2 * rank] >= 0) {
+                close(this->doorbells[2 * rank]);
+                this->doorbells[2 * rank] = -1;
+            }
+        }
+    }
+
+    void release() {
+        for (auto fd: this->doorbells) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        this->doorbells.clear();
+        if (this->mailboxes != MAP_FAILED) {
+            munmap(this->mailboxes, this->mappingBytes);
+            this->mailboxes = MAP_FAILED;
+        }
+    }
+};
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "Pruning.h"
+#include "Semiring.h"
+#include "SparseRowWiseMatrix.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace Barta {
+
+// Doubly compressed row-wise matrix: only the non-empty rows are stored, each by its row index and offset,
+// so the memory and the kernel loops depend on the number of non-empty rows instead of the height.
+template<NumericType T>
+class HypersparseRowWiseMatrix {
+public:
+    using VectorType = std::vector<T>;
+    using TripletType = Triplet<T>;
+    using GeneralType = SparseRowWiseMatrix<T>;
+
+    unsigned int width;
+    unsigned int height;
+
+    std::vector<T> values;
+    std::vector<unsigned int> columnIndices;
+    std::vector<unsigned int> rowIndices;
+    std::vector<unsigned int> offsets; // rowIndices.size() + 1 elements
+
+    HypersparseRowWiseMatrix(
+        unsigned int width,
+        unsigned int height
+    ):
+        width(width),
+        height(height),
+        offsets(1, 0) {}
+
+    HypersparseRowWiseMatrix(
+        unsigned int width,
+        unsigned int height,
+        std::vector<TripletType> triplets,
+        bool sorted = false,
+        bool merged = false
+    ):
+        HypersparseRowWiseMatrix(width, height) {
+        if (!sorted) {
+            TripletType::sort(triplets);
+        }
+
+        if (!merged) {
+            triplets = TripletType::mergeSorted(triplets);
+        }
+
+        this->values.reserve(triplets.size());
+        this->columnIndices.reserve(triplets.size());
+        for (const auto& triplet: triplets) {
+            if (this->rowIndices.empty() || this->rowIndices.back() != triplet.row) {
+                this->rowIndices.push_back(triplet.row);
+                this->offsets.push_back(this->offsets.back());
+            }
+
+            this->values.push_back(triplet.val);
+            this->columnIndices.push_back(triplet.col);
+            ++this->offsets.back();
+        }
+    }
+
+    static HypersparseRowWiseMatrix fromGeneral(
+        const GeneralType& general
+    ) {
+        const auto& offsets = general.getOffsets();
+        HypersparseRowWiseMatrix matrix(general.width, general.height);
+        matrix.values = general.values;
+        matrix.columnIndices = general.getColumnIndices();
+        for (unsigned int row = 0; row < general.height; row++) {
+            if (offsets[row + 1] > offsets[row]) {
+                matrix.rowIndices.push_back(row);
+                matrix.offsets.push_back(offsets[row + 1]);
+            }
+        }
+
+        return matrix;
+    }
+
+    GeneralType toGeneral() const {
+        SparsityPattern pattern(this->height);
+        pattern.columnIndices = this->columnIndices;
+        for (unsigned int k = 0; k < this->rowIndices.size(); k++) {
+            pattern.offsets[this->rowIndices[k] + 1] = this->offsets[k + 1] - this->offsets[k];
+        }
+
+        for (unsigned int row = 0; row < this->height; row++) {
+            pattern.offsets[row + 1] += pattern.offsets[row];
+        }
+
+        return GeneralType(this->width, this->height, std::make_shared<const SparsityPattern>(std::move(pattern)), this->values);
+    }
+
+    double emptyRowRatio() const { return this->height == 0 ? 0. : 1. - static_cast<double>(this->rowIndices.size()) / this->height; }
+
+    // results of the non-empty rows, in the order of rowIndices
+    VectorType multiplyNonEmptyRows(
+        const VectorType& v
+    ) const {
+        assert(this->width == v.size());
+
+        auto ret = VectorType(this->rowIndices.size(), static_cast<T>(0));
+        for (unsigned int k = 0; k < this->rowIndices.size(); k++) {
+            T value = static_cast<T>(0);
+            for (auto i = this->offsets[k]; i < this->offsets[k + 1]; i++) {
+                value += this->values[i] * v[this->columnIndices[i]];
+            }
+
+            ret[k] = value;
+        }
+
+        return ret;
+    }
+
+    VectorType operator*(
+        const VectorType& v
+    ) const {
+        auto nonEmptyRows = this->multiplyNonEmptyRows(v);
+        auto ret = VectorType(this->height, static_cast<T>(0));
+        for (unsigned int k = 0; k < this->rowIndices.size(); k++) {
+            ret[this->rowIndices[k]] = nonEmptyRows[k];
+        }
+
+        return ret;
+    }
+
+    // Row-wise product visiting only the non-empty rows of both operands; the rows of other are found by a binary search
+    // and merged by the row kernel of SparseRowWiseMatrix.
+    template<Semiring<T> S = PlusTimes<T>>
+    HypersparseRowWiseMatrix multiplyRowWise(
+        const HypersparseRowWiseMatrix& other,
+        const unsigned int initialQueueCapacity,
+        const unsigned int thread_num,
+        const Pruning<T>& pruning = {}
+    ) const {
+        std::vector<std::vector<TripletType>> vectorOfTriplets(this->rowIndices.size());
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        std::atomic<unsigned int> counter(0);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([this, &other, initialQueueCapacity, &pruning, &counter, &vectorOfTriplets] () {
+                while (true) {
+                    unsigned int k_l = counter++;
+                    if (k_l >= this->rowIndices.size()) {
+                        break;
+                    }
+
+                    auto beg = this->offsets[k_l];
+                    GeneralType::template multiplyRowRowWise<S>(
+                        this->rowIndices[k_l],
+                        this->values.data() + beg,
+                        this->columnIndices.data() + beg,
+                        this->offsets[k_l + 1] - beg,
+                        other.values.data(),
+                        other.columnIndices.data(),
+                        [&other] (unsigned int row_r) {
+                            auto k_r = other.findRow(row_r);
+                            if (k_r == other.rowIndices.size()) {
+                                return std::pair<unsigned int, unsigned int>(0, 0);
+                            }
+
+                            return std::pair<unsigned int, unsigned int>(other.offsets[k_r], other.offsets[k_r + 1]);
+                        },
+                        initialQueueCapacity,
+                        vectorOfTriplets[k_l],
+                        pruning
+                    );
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        HypersparseRowWiseMatrix result(other.width, this->height);
+        for (const auto& triplets: vectorOfTriplets) {
+            if (triplets.empty()) {
+                continue;
+            }
+
+            result.rowIndices.push_back(triplets.front().row);
+            for (const auto& triplet: triplets) {
+                result.values.push_back(triplet.val);
+                result.columnIndices.push_back(triplet.col);
+            }
+
+            result.offsets.push_back(result.values.size());
+        }
+
+        return result;
+    }
+
+private:
+    // position of row in rowIndices, rowIndices.size() for an empty row
+    unsigned int findRow(
+        unsigned int row
+    ) const {
+        auto it = std::lower_bound(this->rowIndices.begin(), this->rowIndices.end(), row);
+        if (it == this->rowIndices.end() || *it != row) {
+            return this->rowIndices.size();
+        }
+
+        return it - this->rowIndices.begin();
+    }
+};
+
+template<NumericType T>
+using RowWiseStorage = std::variant<SparseRowWiseMatrix<T>, HypersparseRowWiseMatrix<T>>;
+
+// The doubly compressed format stores two indices per non-empty row instead of one offset per row,
+// so it is smaller once more than half of the rows are empty.
+constexpr double defaultHypersparseThreshold = 0.5;
+
+// Builds the hypersparse format when the ratio of empty rows exceeds threshold, the plain one otherwise.
+// The row offsets of the plain format are never allocated for a hypersparse matrix.
+template<NumericType T>
+RowWiseStorage<T> makeRowWiseStorage(
+    unsigned int width,
+    unsigned int height,
+    std::vector<Triplet<T>> triplets,
+    double threshold = defaultHypersparseThreshold
+) {
+    Triplet<T>::sort(triplets);
+    size_t nonEmptyRows = 0;
+    for (size_t i = 0; i < triplets.size(); i++) {
+        if (i == 0 || triplets[i].row != triplets[i - 1].row) {
+            ++nonEmptyRows;
+        }
+    }
+
+    if (height > 0 && 1. - static_cast<double>(nonEmptyRows) / height > threshold) {
+        return HypersparseRowWiseMatrix<T>(width, height, std::move(triplets), true);
+    }
+
+    return SparseRowWiseMatrix<T>(width, height, std::move(triplets), true);
+}
+
+template<NumericType T>
+RowWiseStorage<T> makeRowWiseStorage(
+    const SparseRowWiseMatrix<T>& matrix,
+    double threshold = defaultHypersparseThreshold
+) {
+    if (matrix.emptyRowRatio() > threshold) {
+        return HypersparseRowWiseMatrix<T>::fromGeneral(matrix);
+    }
+
+    return matrix;
+}
+}
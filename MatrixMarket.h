@@ -0,0 +1,118 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "SparseRowWiseMatrix.h"
+#include "SymmetricSparseRowWiseMatrix.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Barta {
+
+struct MatrixMarketHeader {
+    std::string object;
+    std::string format;
+    std::string field;
+    std::string symmetry;
+
+    bool isSymmetric() const { return this->symmetry == "symmetric"; }
+};
+
+// Coordinate Matrix Market file. Symmetric files keep only the stored (lower) triangle in triplets.
+template<NumericType T>
+struct MatrixMarketFile {
+    using TripletType = Triplet<T>;
+
+    MatrixMarketHeader header;
+    unsigned int width;
+    unsigned int height;
+    std::vector<TripletType> triplets;
+
+    static MatrixMarketFile read(
+        std::istream& in
+    ) {
+        MatrixMarketFile file;
+        std::string line;
+        if (!std::getline(in, line)) {
+            throw std::runtime_error("empty Matrix Market file!");
+        }
+
+        std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return std::tolower(c); });
+        std::stringstream banner(line);
+        std::string magic;
+        banner >> magic >> file.header.object >> file.header.format >> file.header.field >> file.header.symmetry;
+        if (magic != "%%matrixmarket" || file.header.object != "matrix") {
+            throw std::runtime_error("not a Matrix Market matrix!");
+        }
+
+        if (file.header.format != "coordinate") {
+            throw std::runtime_error("only the coordinate Matrix Market format is supported!");
+        }
+
+        if (file.header.field == "complex") {
+            throw std::runtime_error("complex Matrix Market matrices are not supported!");
+        }
+
+        while (std::getline(in, line) && (line.empty() || line[0] == '%')) {}
+
+        unsigned int nnz;
+        std::stringstream sizes(line);
+        if (!(sizes >> file.height >> file.width >> nnz)) {
+            throw std::runtime_error("invalid Matrix Market size line!");
+        }
+
+        bool isPattern = file.header.field == "pattern";
+        file.triplets.reserve(nnz);
+        for (unsigned int i = 0; i < nnz; i++) {
+            unsigned int row, col;
+            double value = 1.;
+            in >> row >> col;
+            if (!isPattern) {
+                in >> value;
+            }
+
+            if (!in || row < 1 || col < 1 || row > file.height || col > file.width) {
+                throw std::runtime_error("invalid Matrix Market entry!");
+            }
+
+            file.triplets.emplace_back(row - 1, col - 1, static_cast<T>(value));
+        }
+
+        return file;
+    }
+
+    SparseRowWiseMatrix<T> toGeneral() const {
+        if (this->header.symmetry == "general") {
+            return SparseRowWiseMatrix<T>(this->width, this->height, this->triplets);
+        }
+
+        if (this->header.symmetry == "hermitian") {
+            throw std::runtime_error("hermitian Matrix Market matrices are not supported!");
+        }
+
+        auto sign = static_cast<T>(this->header.symmetry == "skew-symmetric" ? -1 : 1);
+        std::vector<TripletType> triplets;
+        triplets.reserve(2 * this->triplets.size());
+        for (const auto& triplet: this->triplets) {
+            triplets.push_back(triplet);
+            if (triplet.row != triplet.col) {
+                triplets.emplace_back(triplet.col, triplet.row, sign * triplet.val);
+            }
+        }
+
+        return SparseRowWiseMatrix<T>(this->width, this->height, std::move(triplets));
+    }
+
+    SymmetricSparseRowWiseMatrix<T> toSymmetric() const {
+        if (!this->header.isSymmetric()) {
+            throw std::runtime_error("Matrix Market matrix is not symmetric!");
+        }
+
+        return SymmetricSparseRowWiseMatrix<T>(this->height, this->triplets);
+    }
+};
+}
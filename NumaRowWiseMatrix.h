@@ -0,0 +1,163 @@
+#pragma once
+
+#include "NumaTopology.h"
+#include "NumericTypeConcept.h"
+#include "Pruning.h"
+#include "SparseRowWiseMatrix.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+// Row-wise matrix split into nnz-balanced row blocks, one per worker. Every worker is pinned to a fixed CPU
+// and allocates and first-touches its own block, so the pages land on the NUMA node that later processes them.
+template<NumericType T>
+class NumaRowWiseMatrix {
+    struct Partition {
+        NumaCpu cpu;
+        unsigned int rowBeg;
+        unsigned int rowEnd;
+        // arrays are allocated without initialization, so they are first touched by the pinned worker
+        std::unique_ptr<T[]> values;
+        std::unique_ptr<unsigned int[]> columnIndices;
+        std::unique_ptr<unsigned int[]> offsets;
+    };
+
+    std::vector<Partition> partitions;
+
+public:
+    using VectorType = std::vector<T>;
+    using TripletType = Triplet<T>;
+    using GeneralType = SparseRowWiseMatrix<T>;
+
+    // bytes counts the streamed arrays of the partition (values, column indices, offsets) and the written results;
+    // the gathered entries of v are left out, since how many of them come from the caches depends on the pattern
+    struct WorkerStats {
+        NumaCpu cpu;
+        size_t bytes;
+        double seconds;
+    };
+
+    unsigned int width;
+    unsigned int height;
+
+    NumaRowWiseMatrix(
+        const GeneralType& matrix,
+        unsigned int thread_num,
+        const NumaTopology& topology = NumaTopology::detect()
+    ):
+        partitions(thread_num),
+        width(matrix.width),
+        height(matrix.height) {
+        auto rowBlocks = matrix.getPattern()->balancedRowBlocks(thread_num);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            this->partitions[t].cpu = topology.cpuOfWorker(t, thread_num);
+            this->partitions[t].rowBeg = rowBlocks[t];
+            this->partitions[t].rowEnd = rowBlocks[t + 1];
+        }
+
+        NumaRowWiseMatrix::runOnWorkers(this->partitions, [&matrix] (Partition& partition) {
+            const auto& offsets = matrix.getOffsets();
+            const auto& columnIndices = matrix.getColumnIndices();
+            auto beg = offsets[partition.rowBeg];
+            auto nnz = offsets[partition.rowEnd] - beg;
+            auto rows = partition.rowEnd - partition.rowBeg;
+            partition.values.reset(new T[nnz]);
+            partition.columnIndices.reset(new unsigned int[nnz]);
+            partition.offsets.reset(new unsigned int[rows + 1]);
+            std::copy(matrix.values.begin() + beg, matrix.values.begin() + beg + nnz, partition.values.get());
+            std::copy(columnIndices.begin() + beg, columnIndices.begin() + beg + nnz, partition.columnIndices.get());
+            for (unsigned int row = 0; row <= rows; row++) {
+                partition.offsets[row] = offsets[partition.rowBeg + row] - beg;
+            }
+        });
+    }
+
+    // stats, if given, receive the streamed bytes and the time of every worker
+    VectorType multiply(
+        const VectorType& v,
+        std::vector<WorkerStats>* stats = nullptr
+    ) const {
+        assert(this->width == v.size());
+
+        auto ret = VectorType(this->height, static_cast<T>(0));
+        if (stats != nullptr) {
+            stats->assign(this->partitions.size(), {});
+        }
+
+        NumaRowWiseMatrix::runOnWorkers(this->partitions, [this, &v, &ret, stats] (const Partition& partition) {
+            auto beg = std::chrono::steady_clock::now();
+            auto rows = partition.rowEnd - partition.rowBeg;
+            for (unsigned int row = 0; row < rows; row++) {
+                T value = static_cast<T>(0);
+                for (auto i = partition.offsets[row]; i < partition.offsets[row + 1]; i++) {
+                    value += partition.values[i] * v[partition.columnIndices[i]];
+                }
+
+                ret[partition.rowBeg + row] = value;
+            }
+
+            if (stats != nullptr) {
+                auto& workerStats = (*stats)[&partition - this->partitions.data()];
+                workerStats.cpu = partition.cpu;
+                workerStats.bytes = partition.offsets[rows] * (sizeof(T) + sizeof(unsigned int)) + rows * (sizeof(unsigned int) + sizeof(T));
+                workerStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+            }
+        });
+
+        return ret;
+    }
+
+    GeneralType multiplyRowWise(
+        const GeneralType& other,
+        const unsigned int initialQueueCapacity,
+        const Pruning<T>& pruning = {}
+    ) const {
+        std::vector<std::vector<TripletType>> vectorOfTriplets(this->height);
+        auto otherView = other.view();
+        NumaRowWiseMatrix::runOnWorkers(this->partitions, [&otherView, initialQueueCapacity, &pruning, &vectorOfTriplets] (const Partition& partition) {
+            for (auto row_l = partition.rowBeg; row_l < partition.rowEnd; row_l++) {
+                auto beg = partition.offsets[row_l - partition.rowBeg];
+                GeneralType::multiplyRowRowWise(
+                    row_l,
+                    partition.values.get() + beg,
+                    partition.columnIndices.get() + beg,
+                    partition.offsets[row_l - partition.rowBeg + 1] - beg,
+                    otherView,
+                    initialQueueCapacity,
+                    vectorOfTriplets[row_l],
+                    pruning
+                );
+            }
+        });
+
+        return GeneralType(other.width, this->height, std::move(vectorOfTriplets));
+    }
+
+private:
+    // one pinned thread per partition; Partitions is const for the kernels
+    template<typename Partitions, typename F>
+    static void runOnWorkers(
+        Partitions& partitions,
+        F f
+    ) {
+        std::vector<std::thread> threads;
+        threads.reserve(partitions.size());
+        for (auto& partition: partitions) {
+            threads.emplace_back([&partition, &f] () {
+                NumaTopology::pinCurrentThread(partition.cpu);
+                f(partition);
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+};
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#ifdef BARTA_WITH_LIBNUMA
+    #include <numa.h>
+#endif
+
+namespace Barta {
+
+struct NumaCpu {
+    unsigned int cpu;
+    int node;
+};
+
+// CPUs available to the process, ordered by NUMA node. Without libnuma all of them are reported on node 0.
+class NumaTopology {
+public:
+    std::vector<NumaCpu> cpus;
+    int nodeCount = 1;
+
+    static NumaTopology detect() {
+        NumaTopology topology;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                CPU_SET(cpu, &allowed);
+            }
+        }
+
+#ifdef BARTA_WITH_LIBNUMA
+        bool withNuma = numa_available() >= 0;
+        if (withNuma) {
+            topology.nodeCount = numa_max_node() + 1;
+        }
+#endif
+
+        for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                continue;
+            }
+
+            int node = 0;
+#ifdef BARTA_WITH_LIBNUMA
+            if (withNuma) {
+                node = std::max(0, numa_node_of_cpu(cpu));
+            }
+#endif
+            topology.cpus.push_back({cpu, node});
+        }
+
+        std::stable_sort(topology.cpus.begin(), topology.cpus.end(), [](const NumaCpu& l, const NumaCpu& r) { return l.node < r.node; });
+
+        return topology;
+    }
+
+    // Workers are spread evenly over the CPUs, so consecutive workers (and their row blocks) stay on the same node.
+    const NumaCpu& cpuOfWorker(
+        unsigned int worker,
+        unsigned int workerCount
+    ) const {
+        return this->cpus[static_cast<unsigned long long>(worker) * this->cpus.size() / workerCount];
+    }
+
+    // Pins the calling thread and makes its further allocations local to the node of the CPU.
+    static bool pinCurrentThread(
+        const NumaCpu& cpu
+    ) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu.cpu, &set);
+        bool pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#ifdef BARTA_WITH_LIBNUMA
+        if (numa_available() >= 0) {
+            numa_set_localalloc();
+        }
+#endif
+
+        return pinned;
+    }
+};
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <vector>
+
+namespace Barta {
+
+// Per row pruning of a product, applied by the multiplication kernels before a row is stored.
+// An entry is dropped when its magnitude is below absoluteTolerance or below relativeTolerance times
+// the largest magnitude in its row; afterwards only the topK largest entries of the row are kept (0 keeps all).
+template<NumericType T>
+struct Pruning {
+    T absoluteTolerance = static_cast<T>(0);
+    double relativeTolerance = 0.;
+    unsigned int topK = 0;
+
+    bool isEnabled() const { return this->absoluteTolerance > static_cast<T>(0) || this->relativeTolerance > 0. || this->topK > 0; }
+
+    // triplets of one row, sorted by column; the order is kept
+    void apply(
+        std::vector<Triplet<T>>& triplets
+    ) const {
+        if (!this->isEnabled() || triplets.empty()) {
+            return;
+        }
+
+        T maxMagnitude = static_cast<T>(0);
+        for (const auto& triplet: triplets) {
+            maxMagnitude = std::max(maxMagnitude, Pruning::magnitude(triplet.val));
+        }
+
+        double threshold = std::max(static_cast<double>(this->absoluteTolerance), this->relativeTolerance * maxMagnitude);
+        if (threshold > 0.) {
+            std::erase_if(triplets, [threshold](const Triplet<T>& triplet) { return Pruning::magnitude(triplet.val) < threshold; });
+        }
+
+        if (this->topK > 0 && triplets.size() > this->topK) {
+            std::nth_element(triplets.begin(), triplets.begin() + this->topK, triplets.end(), [](const Triplet<T>& l, const Triplet<T>& r) {
+                return Pruning::magnitude(l.val) > Pruning::magnitude(r.val);
+            });
+            triplets.resize(this->topK);
+            std::sort(triplets.begin(), triplets.end(), [](const Triplet<T>& l, const Triplet<T>& r) { return l.col < r.col; });
+        }
+
+        triplets.shrink_to_fit();
+    }
+
+private:
+    static T magnitude(T value) { return value < static_cast<T>(0) ? -value : value; }
+};
+}
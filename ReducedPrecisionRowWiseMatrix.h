@@ -0,0 +1,278 @@
+#pragma once
+
+#include "Pruning.h"
+#include "Semiring.h"
+#include "SparseRowWiseMatrix.h"
+#include "SparsityPattern.h"
+#include "Triplet.h"
+#include "ValueFormat.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+// Row-wise matrix storing its values in a narrow format F (half, bfloat16, scaled int8) while the vectors,
+// the results and the accumulation use Acc. It shares the sparsity pattern of the matrix it was converted from.
+// The kernels decode the values of a row in blocks and accumulate the block in Acc, so SpMV streams
+// 2 or 1 bytes per value instead of sizeof(Acc).
+template<ValueFormat F, std::floating_point Acc = float>
+class ReducedPrecisionRowWiseMatrix {
+public:
+    using StoredType = typename F::StoredType;
+    using VectorType = std::vector<Acc>;
+    using TripletType = Triplet<Acc>;
+    using GeneralType = SparseRowWiseMatrix<Acc>;
+
+    unsigned int width;
+    unsigned int height;
+
+    std::vector<StoredType> values;
+    std::vector<Acc> rowScales; // empty unless F is scaled
+    std::shared_ptr<const SparsityPattern> pattern;
+
+    explicit ReducedPrecisionRowWiseMatrix(
+        const GeneralType& matrix
+    ):
+        width(matrix.width),
+        height(matrix.height),
+        values(matrix.values.size()),
+        pattern(matrix.getPattern()) {
+        const auto& offsets = this->pattern->offsets;
+        if constexpr (F::isScaled) {
+            this->rowScales.resize(this->height, static_cast<Acc>(0));
+        }
+
+        for (unsigned int row = 0; row < this->height; row++) {
+            Acc scale = static_cast<Acc>(1);
+            if constexpr (F::isScaled) {
+                Acc maxMagnitude = static_cast<Acc>(0);
+                for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                    maxMagnitude = std::max(maxMagnitude, std::abs(matrix.values[i]));
+                }
+
+                this->rowScales[row] = maxMagnitude / F::maxCode;
+                scale = maxMagnitude > static_cast<Acc>(0) ? this->rowScales[row] : static_cast<Acc>(1);
+            }
+
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                this->values[i] = F::encode(static_cast<float>(matrix.values[i] / scale));
+            }
+        }
+    }
+
+    const std::shared_ptr<const SparsityPattern>& getPattern() const { return this->pattern; }
+
+    // the values as they are seen by the kernels, for measuring the rounding error
+    GeneralType toGeneral() const {
+        std::vector<Acc> values(this->values.size());
+        std::vector<float> decoded(this->values.size());
+        F::decode(this->values.data(), this->values.size(), decoded.data());
+        for (unsigned int row = 0; row < this->height; row++) {
+            for (auto i = this->pattern->offsets[row]; i < this->pattern->offsets[row + 1]; i++) {
+                values[i] = this->scaled(row, static_cast<Acc>(decoded[i]));
+            }
+        }
+
+        return GeneralType(this->width, this->height, this->pattern, std::move(values));
+    }
+
+    // bytes streamed by SpMV over the Acc matrix divided by the bytes streamed over this one
+    double compressionRatio() const {
+        double indexBytes = (this->pattern->columnIndices.size() + this->pattern->offsets.size()) * sizeof(unsigned int);
+        double plainBytes = indexBytes + this->values.size() * sizeof(Acc);
+        double reducedBytes = indexBytes + this->values.size() * sizeof(StoredType) + this->rowScales.size() * sizeof(Acc);
+
+        return plainBytes / reducedBytes;
+    }
+
+    VectorType operator*(
+        const VectorType& v
+    ) const {
+        return this->multiply(v, 1);
+    }
+
+    VectorType multiply(
+        const VectorType& v,
+        unsigned int thread_num
+    ) const {
+        assert(this->width == v.size());
+
+        auto ret = VectorType(this->height, static_cast<Acc>(0));
+        this->runOnRowBlocks(thread_num, [this, &v, &ret] (unsigned int row, const float* decoded, unsigned int i, unsigned int n) {
+            const auto* columnIndices = this->pattern->columnIndices.data() + i;
+            Acc value = static_cast<Acc>(0);
+            for (unsigned int k = 0; k < n; k++) {
+                value += static_cast<Acc>(decoded[k]) * v[columnIndices[k]];
+            }
+
+            ret[row] += value;
+        });
+
+        this->scaleRows(ret.data(), 1);
+
+        return ret;
+    }
+
+    // SpMM with a dense right-hand side of `columns` vectors, stored row-major (width x columns);
+    // the result is row-major as well (height x columns). Every decoded value is reused for all the vectors.
+    VectorType multiplyDense(
+        const VectorType& x,
+        unsigned int columns,
+        unsigned int thread_num
+    ) const {
+        assert(static_cast<size_t>(this->width) * columns == x.size());
+
+        auto ret = VectorType(static_cast<size_t>(this->height) * columns, static_cast<Acc>(0));
+        this->runOnRowBlocks(thread_num, [this, &x, &ret, columns] (unsigned int row, const float* decoded, unsigned int i, unsigned int n) {
+            const auto* columnIndices = this->pattern->columnIndices.data() + i;
+            Acc* target = ret.data() + static_cast<size_t>(row) * columns;
+            for (unsigned int k = 0; k < n; k++) {
+                auto value = static_cast<Acc>(decoded[k]);
+                const Acc* source = x.data() + static_cast<size_t>(columnIndices[k]) * columns;
+                for (unsigned int c = 0; c < columns; c++) {
+                    target[c] += value * source[c];
+                }
+            }
+        });
+
+        this->scaleRows(ret.data(), columns);
+
+        return ret;
+    }
+
+    // SpGEMM with a full precision right operand; every row of this matrix is decoded once and multiplied
+    // by the row-wise kernel of SparseRowWiseMatrix.
+    template<Semiring<Acc> S = PlusTimes<Acc>>
+    GeneralType multiplyRowWise(
+        const GeneralType& other,
+        const unsigned int initialQueueCapacity,
+        const unsigned int thread_num,
+        const Pruning<Acc>& pruning = {}
+    ) const {
+        std::vector<std::vector<TripletType>> vectorOfTriplets(this->height);
+        auto otherView = other.view();
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        std::atomic<unsigned int> counter(0);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([this, &otherView, initialQueueCapacity, &pruning, &counter, &vectorOfTriplets] () {
+                std::vector<float> decoded;
+                std::vector<Acc> rowValues;
+                while (true) {
+                    unsigned int row_l = counter++;
+                    if (row_l >= this->height) {
+                        break;
+                    }
+
+                    auto beg = this->pattern->offsets[row_l];
+                    auto rowLength = this->pattern->offsets[row_l + 1] - beg;
+                    decoded.resize(rowLength);
+                    rowValues.resize(rowLength);
+                    F::decode(this->values.data() + beg, rowLength, decoded.data());
+                    for (unsigned int k = 0; k < rowLength; k++) {
+                        rowValues[k] = this->scaled(row_l, static_cast<Acc>(decoded[k]));
+                    }
+
+                    GeneralType::template multiplyRowRowWise<S>(
+                        row_l,
+                        rowValues.data(),
+                        this->pattern->columnIndices.data() + beg,
+                        rowLength,
+                        otherView,
+                        initialQueueCapacity,
+                        vectorOfTriplets[row_l],
+                        pruning
+                    );
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        return GeneralType(other.width, this->height, std::move(vectorOfTriplets));
+    }
+
+private:
+    // values decoded at once; small enough for the stack and the L1 cache
+    static constexpr unsigned int decodeBlock = 256;
+
+    Acc scaled(
+        unsigned int row,
+        Acc value
+    ) const {
+        if constexpr (F::isScaled) {
+            return value * this->rowScales[row];
+        } else {
+            return value;
+        }
+    }
+
+    void scaleRows(
+        Acc* ret,
+        unsigned int columns
+    ) const {
+        if constexpr (F::isScaled) {
+            for (unsigned int row = 0; row < this->height; row++) {
+                for (unsigned int c = 0; c < columns; c++) {
+                    ret[static_cast<size_t>(row) * columns + c] *= this->rowScales[row];
+                }
+            }
+        }
+    }
+
+    // Splits the rows into blocks with balanced nonzeros, one per thread, and calls
+    // f(row, decoded values, index of the first value, number of values) for every decoded block of every row.
+    template<typename Func>
+    void runOnRowBlocks(
+        unsigned int thread_num,
+        Func f
+    ) const {
+        auto rowBlocks = this->pattern->balancedRowBlocks(std::max(1u, thread_num));
+        auto runRows = [this, &f] (unsigned int rowBeg, unsigned int rowEnd) {
+            float decoded[decodeBlock];
+            for (auto row = rowBeg; row < rowEnd; row++) {
+                auto end = this->pattern->offsets[row + 1];
+                for (auto i = this->pattern->offsets[row]; i < end; i += decodeBlock) {
+                    auto n = std::min(decodeBlock, end - i);
+                    F::decode(this->values.data() + i, n, decoded);
+                    f(row, decoded, i, n);
+                }
+            }
+        };
+
+        if (thread_num <= 1) {
+            runRows(0, this->height);
+
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([&runRows, &rowBlocks, t] () { runRows(rowBlocks[t], rowBlocks[t + 1]); });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+};
+
+template<std::floating_point Acc = float>
+using HalfRowWiseMatrix = ReducedPrecisionRowWiseMatrix<Float16Format, Acc>;
+
+template<std::floating_point Acc = float>
+using BFloat16RowWiseMatrix = ReducedPrecisionRowWiseMatrix<BFloat16Format, Acc>;
+
+template<std::floating_point Acc = float>
+using Int8RowWiseMatrix = ReducedPrecisionRowWiseMatrix<ScaledInt8Format, Acc>;
+}
@@ -3,10 +3,12 @@
 //
 
 #pragma once
+#include "Semiring.h"
 #include <iostream>
 #include <vector>
 
-template<typename T>
+// entries with equal columns are merged with S::add
+template<typename T, typename S = Barta::PlusTimes<T>>
 class RowQueue {
     struct ListElement {
         T value;
@@ -35,7 +37,7 @@ public:
                 prevLeft = currLeft;
                 currLeft = this->list[currLeft].next;
             } else if (this->list[currLeft].col == this->list[currRight].col) {
-                this->list[currLeft].value += this->list[currRight].value;
+                this->list[currLeft].value = S::add(this->list[currLeft].value, this->list[currRight].value);
                 auto toBeRemoved = currRight;
                 currRight = this->list[currRight].next;
                 if (currRight == this->list.size() - 1) {
@@ -85,7 +87,7 @@ public:
             auto last = this->list.size() - 1;
             auto next = this->list[last].next;
             if (this->list[last].col == col && next < 0) {
-                this->list[last].value += value;
+                this->list[last].value = S::add(this->list[last].value, value);
             } else if (this->list[last].col < col && next < 0) {
                 this->list.push_back(ListElement{value, col, last, next});
                 this->list[last].next = last + 1;
@@ -1,5 +1,16 @@
+#include "../CompressedSparseRowWiseMatrix.h"
 #include "../DenseMatrix.h"
+#include "../HypersparseRowWiseMatrix.h"
 #include "../SparseRowWiseMatrix.h"
+#include "../MatrixMarket.h"
+#include "../NumaRowWiseMatrix.h"
+#include "../ReducedPrecisionRowWiseMatrix.h"
+#include "../SpGemmPlan.h"
+#include "../SymmetricSparseRowWiseMatrix.h"
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <random>
 
 int main() {
     std::vector<Barta::Triplet<float>> tripletsA = {
@@ -63,6 +74,344 @@ int main() {
 
     assert(C == D);
 
+    Barta::Pruning<float> pruning;
+    pruning.absoluteTolerance = 10.f;
+    pruning.topK = 2;
+    auto prunedD = A.multiplyRowWise(B, 4, 2, pruning);
+
+    std::cout << "D pruned: " << prunedD.toString() << std::endl;
+
+    assert(prunedD.values.size() <= 2 * prunedD.height);
+    assert(A.multiplyInnerWithTransposition(B, 2, pruning) == prunedD);
+
+    // rows of different magnitudes times the identity: a relative tolerance prunes each row at its own scale
+    Barta::SparseRowWiseMatrix<float> mixed(3, 2, std::vector<Barta::Triplet<float>>{
+        {0, 0, 1000.f},
+        {0, 1, 50.f  },
+        {0, 2, -2.f  },
+        {1, 0, 5.f   },
+        {1, 1, -0.4f },
+        {1, 2, 0.05f },
+    });
+    Barta::SparseRowWiseMatrix<float> identity(3, 3, std::vector<Barta::Triplet<float>>{{0, 0, 1.f}, {1, 1, 1.f}, {2, 2, 1.f}});
+    Barta::Pruning<float> relativePruning;
+    relativePruning.relativeTolerance = 0.1;
+    Barta::Pruning<float> absolutePruning;
+    absolutePruning.absoluteTolerance = 1.f;
+    Barta::Pruning<float> combinedPruning;
+    combinedPruning.absoluteTolerance = 1.f;
+    combinedPruning.relativeTolerance = 0.01;
+    assert(mixed.multiplyRowWise(identity, 4, 2, relativePruning).values == std::vector<float>({1000.f, 5.f}));
+    assert(mixed.multiplyRowWise(identity, 4, 2, absolutePruning).values == std::vector<float>({1000.f, 50.f, -2.f, 5.f}));
+    // thresholds max(1, 10) = 10 in row 0 and max(1, 0.05) = 1 in row 1
+    assert(mixed.multiplyRowWise(identity, 4, 2, combinedPruning).values == std::vector<float>({1000.f, 50.f, 5.f}));
+
+    auto shortestPaths = A.multiplyRowWise<Barta::MinPlus<float>>(B, 4, 2);
+    auto reachable = A.multiplyRowWise<Barta::Boolean<float>>(B, 4, 2);
+
+    std::cout << "D in (min, +): " << shortestPaths.toString() << std::endl;
+
+    assert(A.multiplyInnerWithTransposition<Barta::MinPlus<float>>(B, 2) == shortestPaths);
+    assert(reachable.sharesPatternWith(D) || reachable.getColumnIndices() == D.getColumnIndices());
+    assert(std::all_of(reachable.values.begin(), reachable.values.end(), [](float value) { return value == 1.f; }));
+
+    // edge weights of a graph 0 -> 1 (4), 0 -> 2 (1), 2 -> 1 (2), 1 -> 2 (5); x holds the distances to node 1,
+    // and one (min, +) product relaxes every node over its outgoing edges
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+    Barta::SparseRowWiseMatrix<float> graph(3, 3, std::vector<Barta::Triplet<float>>{{0, 1, 4.f}, {0, 2, 1.f}, {1, 2, 5.f}, {2, 1, 2.f}});
+    assert(graph.multiply<Barta::MinPlus<float>>({infinity, 0.f, infinity}) == std::vector<float>({4.f, infinity, 2.f}));
+    assert(graph.multiply<Barta::MinPlus<float>>({4.f, 0.f, 2.f}) == std::vector<float>({3.f, 7.f, 2.f}));
+
+    // the same graph with edge probabilities; (max, *) gives the most probable paths
+    Barta::SparseRowWiseMatrix<float> probabilities(3, 3, std::vector<Barta::Triplet<float>>{{0, 1, 0.5f}, {0, 2, 0.8f}, {1, 2, 0.25f}, {2, 1, 0.5f}});
+    assert(probabilities.multiply<Barta::MaxTimes<float>>({0.f, 1.f, 0.f}) == std::vector<float>({0.5f, 0.f, 0.5f}));
+    auto twoSteps = probabilities.multiplyRowWise<Barta::MaxTimes<float>>(probabilities, 4, 2);
+    assert(twoSteps.getColumnIndices() == std::vector<unsigned int>({1, 2, 1, 2}));
+    assert(twoSteps.values == std::vector<float>({0.4f, 0.125f, 0.125f, 0.125f}));
+    assert(A.multiplyBitPacked({0b1}) == std::vector<std::uint64_t>({0b1}));
+
+    auto hypersparseA = Barta::HypersparseRowWiseMatrix<float>::fromGeneral(A);
+    auto hypersparseB = Barta::HypersparseRowWiseMatrix<float>::fromGeneral(B);
+    assert(hypersparseA.multiplyRowWise(hypersparseB, 4, 2).toGeneral() == D);
+    assert(std::holds_alternative<Barta::SparseRowWiseMatrix<float>>(Barta::makeRowWiseStorage(A)));
+
+    // rows 0, 2, 3, 5, 6, 7, 9 are empty; row 8 reaches the empty row 9
+    std::vector<Barta::Triplet<float>> tripletsH = {
+        {1, 4, 2.f },
+        {1, 8, -1.f},
+        {4, 1, 3.f },
+        {8, 4, 5.f },
+        {8, 9, 1.f },
+    };
+    Barta::SparseRowWiseMatrix<float> H(10, 10, tripletsH);
+    auto storageH = Barta::makeRowWiseStorage(10, 10, tripletsH);
+    assert(std::holds_alternative<Barta::HypersparseRowWiseMatrix<float>>(storageH));
+    assert(std::holds_alternative<Barta::HypersparseRowWiseMatrix<float>>(Barta::makeRowWiseStorage(H)));
+
+    const auto& hypersparseH = std::get<Barta::HypersparseRowWiseMatrix<float>>(storageH);
+    std::vector<float> y = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f};
+    assert(hypersparseH.rowIndices == std::vector<unsigned int>({1, 4, 8}));
+    assert(hypersparseH * y == H * y);
+    assert(hypersparseH.multiplyRowWise(hypersparseH, 4, 2).toGeneral() == H.multiplyRowWise(H, 4, 2));
+    assert(hypersparseH.multiplyRowWise<Barta::Boolean<float>>(hypersparseH, 4, 2).toGeneral() == H.multiplyRowWise<Barta::Boolean<float>>(H, 4, 2));
+
+    auto middleRowsOfA = A.rowView(2, 5);
+    auto middleRowsOfD = D.extractSubmatrix(2, 5, 0, 7, 2);
+
+    std::cout << "D[2:5, :]: " << middleRowsOfD.toString() << std::endl;
+
+    assert(middleRowsOfA.multiplyRowWise(B.view(), 4, 2) == middleRowsOfD);
+    assert(A.multiplyRowWise(B.rowView(0, 7), 4, 2) == D);
+    assert(middleRowsOfD.extractSubmatrix(1, 2, 3, 5, 1).values == std::vector<float>({70.f}));
+
+    // column deltas below 2^7, below 2^14 and an escaped one above; 700 rows span three blocks of byte offsets
+    std::vector<Barta::Triplet<float>> tripletsW;
+    for (unsigned int row = 0; row < 700; row++) {
+        if (row % 5 == 4) {
+            continue;
+        }
+
+        for (unsigned int col: {row, row + 100, row + 5000, row + 100000}) {
+            tripletsW.emplace_back(row, col, static_cast<float>(row % 11) - 5.f);
+        }
+    }
+
+    Barta::SparseRowWiseMatrix<float> W(200000, 700, tripletsW);
+    Barta::CompressedSparseRowWiseMatrix<float> compressedW(W);
+    std::vector<float> vW(W.width);
+    for (unsigned int i = 0; i < vW.size(); i++) {
+        vW[i] = static_cast<float>(i % 7);
+    }
+
+    auto expectedW = W.multiply<Barta::PlusTimes<float>>(vW);
+    auto transposedW = W.transposed();
+    assert(std::find(compressedW.encodedColumns.begin(), compressedW.encodedColumns.end(), 0xC0) != compressedW.encodedColumns.end());
+    assert(compressedW.toGeneral() == W);
+    assert(compressedW * vW == expectedW);
+    for (unsigned int thread_num: {2u, 3u, 8u}) {
+        assert(compressedW.multiply(vW, thread_num) == expectedW);
+        assert(compressedW.multiplyRowWise(transposedW, 4, thread_num) == W.multiplyRowWise(transposedW, 4, thread_num));
+    }
+
+    // one entry per row, where a per-row byte offset would have cost more than the compressed indices save
+    std::vector<Barta::Triplet<float>> tripletsDiagonal;
+    for (unsigned int row = 0; row < 1000; row++) {
+        tripletsDiagonal.emplace_back(row, row, 1.f);
+    }
+
+    assert(Barta::CompressedSparseRowWiseMatrix<float>(Barta::SparseRowWiseMatrix<float>(1000, 1000, tripletsDiagonal)).compressionRatio() > 1.);
+
+    // more workers than rows leaves some partitions empty
+    for (unsigned int thread_num: {1u, 3u, 10u}) {
+        Barta::NumaRowWiseMatrix<float> numaA(A, thread_num);
+        std::vector<float> numaX = {1.f, -2.f, 3.f, 4.f, 5.f, 6.f, 7.f};
+        std::vector<Barta::NumaRowWiseMatrix<float>::WorkerStats> numaStats;
+        assert(numaA.multiply(numaX, &numaStats) == A * numaX);
+        assert(numaStats.size() == thread_num);
+        assert(numaA.multiplyRowWise(B, 4) == D);
+    }
+
+    auto futureD = A.multiplyRowWiseAsync(B, 4);
+    auto futureC2 = A.multiplyInnerWithTranspositionAsync(B);
+    assert(futureD.get() == D);
+    assert(futureC2.get() == C2);
+
+    Barta::SpGemmPlan plan(A, B);
+    auto E = plan.createResult();
+    plan.execute(A, B, E);
+
+    std::cout << "E: " << E.toString() << std::endl;
+
+    assert(D == E);
+
+    auto B2 = B.withValues(std::vector<float>(B.values.size(), 1.f));
+    plan.execute(A, B2, E);
+
+    assert(A.multiplyRowWise(B2, 4, 2) == E);
+
+    // row i of U has (i % 13)^2 entries, so the rows handed to the threads differ widely in cost
+    std::mt19937 planGenerator(7);
+    std::vector<Barta::Triplet<float>> tripletsU;
+    for (unsigned int row = 0; row < 300; row++) {
+        for (unsigned int k = 0; k < (row % 13) * (row % 13); k++) {
+            tripletsU.emplace_back(row, planGenerator() % 300, static_cast<float>(planGenerator() % 19) - 9.f);
+        }
+    }
+
+    Barta::SparseRowWiseMatrix<float> U(300, 300, tripletsU);
+    Barta::SpGemmPlan planU(U, U);
+    auto serialU = planU.execute(U, U);
+    assert(planU.execute(U, U, 4) == serialU);
+    assert(planU.execute(U, U, 301) == serialU);
+
+    std::stringstream mtx(
+        "%%MatrixMarket matrix coordinate real symmetric\n"
+        "% lower triangle\n"
+        "4 4 6\n"
+        "1 1 4\n"
+        "2 1 -1\n"
+        "2 2 4\n"
+        "3 2 -1\n"
+        "3 3 4\n"
+        "4 1 2\n"
+    );
+    auto mtxFile = Barta::MatrixMarketFile<float>::read(mtx);
+    auto S = mtxFile.toSymmetric();
+    auto SGeneral = mtxFile.toGeneral();
+
+    std::cout << "S: " << S.toGeneral().toString() << std::endl;
+
+    assert(S.toGeneral() == SGeneral);
+    assert(Barta::SymmetricSparseRowWiseMatrix<float>::fromGeneral(SGeneral).upper == S.upper);
+
+    std::vector<float> x = {1.f, 2.f, 3.f, 4.f};
+    assert(S * x == SGeneral * x);
+    assert(S.multiply(x, 3) == SGeneral * x);
+
+    // A is not symmetric, so A^T v differs from A v; the top rows of A are not square
+    auto topRowsOfA = A.extractSubmatrix(0, 5, 0, 7, 1);
+    std::vector<float> z = {1.f, -2.f, 3.f, 4.f, 5.f, 6.f, 7.f};
+    std::vector<float> zTop(z.begin(), z.begin() + 5);
+    for (auto strategy: {
+             Barta::TransposedProductStrategy::Automatic,
+             Barta::TransposedProductStrategy::PrivateBuffers,
+             Barta::TransposedProductStrategy::Atomics
+         }) {
+        for (unsigned int thread_num: {1u, 2u, 3u}) {
+            assert(A.multiplyTransposed(z, thread_num, strategy) == A.transposed() * z);
+            assert(topRowsOfA.multiplyTransposed(zTop, thread_num, strategy) == topRowsOfA.transposed().multiply<Barta::PlusTimes<float>>(zTop));
+        }
+    }
+
+    assert(A.multiplyTransposed(z, 2) != A * z);
+
+    // repeated products see every change of the values
+    auto changedA = A;
+    for (int call = 0; call < 3; call++) {
+        assert(changedA.multiplyTransposed(z, 2) == A.transposed() * z);
+    }
+
+    changedA.insert(5, 0, 2.f);
+    assert(changedA.multiplyTransposed(z, 2) == changedA.transposed() * z);
+    assert(changedA.multiplyTransposed(z, 2) != A.transposed() * z);
+    changedA.values[0] = 9.f;
+    assert(changedA.multiplyTransposed(z, 2) == changedA.transposed() * z);
+
+    // random values over six orders of magnitude, which none of the narrow formats represents exactly
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<unsigned int> randomIndex(0, 199);
+    std::uniform_real_distribution<float> randomExponent(-3.f, 3.f);
+    std::uniform_real_distribution<float> randomEntry(-1.f, 1.f);
+    std::vector<Barta::Triplet<float>> tripletsR;
+    for (int i = 0; i < 2000; i++) {
+        float magnitude = std::pow(10.f, randomExponent(generator));
+        tripletsR.emplace_back(randomIndex(generator), randomIndex(generator), randomEntry(generator) < 0.f ? -magnitude : magnitude);
+    }
+
+    Barta::SparseRowWiseMatrix<float> R(200, 200, tripletsR);
+    std::vector<float> vR(R.width);
+    for (auto& entry: vR) {
+        entry = randomEntry(generator);
+    }
+
+    // the error of a row is relative to sum |a_ij v_j|, the scale of the rounding errors of its products
+    auto relativeError = [&R] (const std::vector<float>& v, const std::vector<float>& result) {
+        auto reference = R.multiply<Barta::PlusTimes<float>>(v);
+        const auto& offsets = R.getOffsets();
+        const auto& columnIndices = R.getColumnIndices();
+        float error = 0.f;
+        for (unsigned int row = 0; row < R.height; row++) {
+            float scale = 0.f;
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                scale += std::abs(R.values[i] * v[columnIndices[i]]);
+            }
+
+            if (scale > 0.f) {
+                error = std::max(error, std::abs(result[row] - reference[row]) / scale);
+            }
+        }
+
+        return error;
+    };
+
+    // SpMM multiplies a row-major block of three vectors: vR, vR reversed and the squares of vR
+    constexpr unsigned int columnsX = 3;
+    std::vector<std::vector<float>> columnVectors = {vR, std::vector<float>(vR.rbegin(), vR.rend()), vR};
+    for (auto& entry: columnVectors[2]) {
+        entry *= entry;
+    }
+
+    std::vector<float> xR(R.width * columnsX);
+    for (unsigned int j = 0; j < R.width; j++) {
+        for (unsigned int c = 0; c < columnsX; c++) {
+            xR[j * columnsX + c] = columnVectors[c][j];
+        }
+    }
+
+    auto reportError = [&R, &vR, &relativeError, &columnVectors, &xR] (const char* name, const auto& reduced, float bound) {
+        float error = relativeError(vR, reduced.multiply(vR, 2));
+        auto resultX = reduced.multiplyDense(xR, columnsX, 2);
+        float errorX = 0.f;
+        for (unsigned int c = 0; c < columnsX; c++) {
+            std::vector<float> column(R.height);
+            for (unsigned int row = 0; row < R.height; row++) {
+                column[row] = resultX[row * columnsX + c];
+            }
+
+            errorX = std::max(errorX, relativeError(columnVectors[c], column));
+        }
+
+        std::cout << name << " SpMV relative error: " << error << ", SpMM relative error: " << errorX;
+        std::cout << ", compression: " << reduced.compressionRatio() << std::endl;
+        assert(error > 0.f && error <= bound);
+        assert(errorX > 0.f && errorX <= bound);
+        assert(reduced.multiplyRowWise(R, 4, 2) == reduced.toGeneral().multiplyRowWise(R, 4, 2));
+    };
+    reportError("half", Barta::HalfRowWiseMatrix<float>(R), 1e-3f);
+    reportError("bfloat16", Barta::BFloat16RowWiseMatrix<float>(R), 1e-2f);
+    reportError("int8", Barta::Int8RowWiseMatrix<float>(R), 0.25f);
+
+    // every half code converts back to itself
+    for (std::uint32_t code = 0; code < 0x10000; code++) {
+        float value = Barta::Float16Format::decode(static_cast<std::uint16_t>(code));
+        if (!std::isnan(value)) {
+            assert(Barta::Float16Format::encodeSoftware(value) == code);
+        }
+#ifdef __F16C__
+        assert(std::bit_cast<std::uint32_t>(value) == std::bit_cast<std::uint32_t>(_cvtsh_ss(code)) || std::isnan(value));
+#endif
+    }
+
+    // the software encoder rounds every float of a strided sweep to the nearest half, ties to even
+    for (std::uint64_t bits = 0; bits <= 0xFFFFFFFF; bits += 4099) {
+        float value = std::bit_cast<float>(static_cast<std::uint32_t>(bits));
+        if (std::isnan(value)) {
+            continue;
+        }
+
+        auto code = Barta::Float16Format::encodeSoftware(value);
+#ifdef __F16C__
+        assert(code == _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+#endif
+        std::uint16_t sign = code & 0x8000;
+        std::uint16_t magnitude = code & 0x7FFF;
+        if (std::abs(value) >= 65520.f) {
+            assert(magnitude == 0x7C00);
+            continue;
+        }
+
+        auto distance = [value] (std::uint16_t code) { return std::abs(static_cast<double>(Barta::Float16Format::decode(code)) - value); };
+        assert(magnitude < 0x7C00);
+        if (magnitude > 0) {
+            assert(distance(code) <= distance(sign | (magnitude - 1)));
+            assert(distance(code) < distance(sign | (magnitude - 1)) || magnitude % 2 == 0);
+        }
+
+        assert(distance(code) <= distance(sign | (magnitude + 1)));
+        assert(distance(code) < distance(sign | (magnitude + 1)) || magnitude % 2 == 0);
+    }
+
+
     std::cout << std::endl;
 
     return 0;
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include <concepts>
+#include <limits>
+
+namespace Barta {
+
+// (add, multiply) pair used by the kernels instead of (+, *). zero() is the identity of add and entries
+// equal to it are not emitted by the inner product kernel.
+template<typename S, typename T>
+concept Semiring = NumericType<T> && requires(T a, T b) {
+    { S::zero() } -> std::same_as<T>;
+    { S::add(a, b) } -> std::same_as<T>;
+    { S::multiply(a, b) } -> std::same_as<T>;
+    { S::isBoolean } -> std::convertible_to<bool>;
+};
+
+// the ordinary arithmetic
+template<NumericType T>
+struct PlusTimes {
+    static constexpr bool isBoolean = false;
+
+    static constexpr T zero() { return static_cast<T>(0); }
+
+    static constexpr T add(T a, T b) { return a + b; }
+
+    static constexpr T multiply(T a, T b) { return a * b; }
+};
+
+// tropical semiring (shortest paths); zero() is the infinite distance
+template<NumericType T>
+struct MinPlus {
+    static constexpr bool isBoolean = false;
+
+    static constexpr T zero() {
+        if constexpr (std::numeric_limits<T>::has_infinity) {
+            return std::numeric_limits<T>::infinity();
+        } else {
+            return std::numeric_limits<T>::max();
+        }
+    }
+
+    // written as a select, so it compiles to a branch-free min
+    static constexpr T add(T a, T b) { return b < a ? b : a; }
+
+    static constexpr T multiply(T a, T b) {
+        if constexpr (std::numeric_limits<T>::has_infinity) {
+            return a + b;
+        } else {
+            return a == zero() || b == zero() ? zero() : a + b;
+        }
+    }
+};
+
+// most probable paths over non-negative weights
+template<NumericType T>
+struct MaxTimes {
+    static constexpr bool isBoolean = false;
+
+    static constexpr T zero() { return static_cast<T>(0); }
+
+    static constexpr T add(T a, T b) { return a < b ? b : a; }
+
+    static constexpr T multiply(T a, T b) { return a * b; }
+};
+
+// reachability; any nonzero value is true and results are 0 or 1
+template<NumericType T>
+struct Boolean {
+    static constexpr bool isBoolean = true;
+
+    static constexpr T zero() { return static_cast<T>(0); }
+
+    static constexpr T add(T a, T b) { return static_cast<T>((a != zero()) | (b != zero())); }
+
+    static constexpr T multiply(T a, T b) { return static_cast<T>((a != zero()) & (b != zero())); }
+};
+}
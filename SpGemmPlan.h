@@ -0,0 +1,181 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "SparseRowWiseMatrix.h"
+#include "SparsityPattern.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+// Symbolic part of the product left * right. Once built, the product of any matrices with the same
+// patterns as the planned ones is recomputed by execute() without allocating.
+// Unlike multiplyRowWise, structural zeros (cancellations) are kept in the result pattern.
+template<NumericType T>
+class SpGemmPlan {
+    using MatrixType = SparseRowWiseMatrix<T>;
+
+    unsigned int width;
+    unsigned int height;
+    std::shared_ptr<const SparsityPattern> leftPattern;
+    std::shared_ptr<const SparsityPattern> rightPattern;
+    std::shared_ptr<const SparsityPattern> resultPattern;
+
+    // for every product term left[i_l] * right[i_r], in the order of execution, the index of the result value
+    std::vector<unsigned int> scatterMap;
+    std::vector<size_t> termOffsets;
+
+public:
+    SpGemmPlan(
+        const MatrixType& left,
+        const MatrixType& right
+    ):
+        width(right.width),
+        height(left.height),
+        leftPattern(left.getPattern()),
+        rightPattern(right.getPattern()),
+        termOffsets(left.height + 1, 0) {
+        assert(left.width == right.height);
+
+        const auto& offsets_l = this->leftPattern->offsets;
+        const auto& columnIndices_l = this->leftPattern->columnIndices;
+        const auto& offsets_r = this->rightPattern->offsets;
+        const auto& columnIndices_r = this->rightPattern->columnIndices;
+
+        SparsityPattern pattern(this->height);
+        std::vector<unsigned int> marker(this->width, this->height);
+        std::vector<unsigned int> position(this->width, 0);
+        std::vector<unsigned int> rowColumns;
+        for (unsigned int row_l = 0; row_l < this->height; row_l++) {
+            rowColumns.clear();
+            for (auto i_l = offsets_l[row_l]; i_l < offsets_l[row_l + 1]; ++i_l) {
+                auto row_r = columnIndices_l[i_l];
+                for (auto i_r = offsets_r[row_r]; i_r < offsets_r[row_r + 1]; ++i_r) {
+                    auto col = columnIndices_r[i_r];
+                    if (marker[col] != row_l) {
+                        marker[col] = row_l;
+                        rowColumns.push_back(col);
+                    }
+                }
+            }
+
+            std::sort(rowColumns.begin(), rowColumns.end());
+            unsigned int rowBeg = pattern.columnIndices.size();
+            for (unsigned int k = 0; k < rowColumns.size(); k++) {
+                position[rowColumns[k]] = rowBeg + k;
+                pattern.columnIndices.push_back(rowColumns[k]);
+            }
+
+            pattern.offsets[row_l + 1] = pattern.columnIndices.size();
+
+            for (auto i_l = offsets_l[row_l]; i_l < offsets_l[row_l + 1]; ++i_l) {
+                auto row_r = columnIndices_l[i_l];
+                for (auto i_r = offsets_r[row_r]; i_r < offsets_r[row_r + 1]; ++i_r) {
+                    this->scatterMap.push_back(position[columnIndices_r[i_r]]);
+                }
+            }
+
+            this->termOffsets[row_l + 1] = this->scatterMap.size();
+        }
+
+        this->resultPattern = std::make_shared<const SparsityPattern>(std::move(pattern));
+    }
+
+    const std::shared_ptr<const SparsityPattern>& getResultPattern() const { return this->resultPattern; }
+
+    // zero-filled matrix with the result pattern to be passed to execute()
+    MatrixType createResult() const {
+        return MatrixType(this->width, this->height, this->resultPattern, std::vector<T>(this->resultPattern->nonZeros(), static_cast<T>(0)));
+    }
+
+    MatrixType execute(
+        const MatrixType& left,
+        const MatrixType& right,
+        unsigned int thread_num = 1
+    ) const {
+        auto result = this->createResult();
+        this->execute(left, right, result, thread_num);
+
+        return result;
+    }
+
+    void execute(
+        const MatrixType& left,
+        const MatrixType& right,
+        MatrixType& result,
+        unsigned int thread_num = 1
+    ) const {
+        if (!SpGemmPlan::matches(left.getPattern(), this->leftPattern) || !SpGemmPlan::matches(right.getPattern(), this->rightPattern)) {
+            throw std::runtime_error("operand pattern differs from the planned one!");
+        }
+
+        if (!SpGemmPlan::matches(result.getPattern(), this->resultPattern)) {
+            throw std::runtime_error("result pattern differs from the planned one!");
+        }
+
+        if (thread_num <= 1) {
+            this->executeRows(left, right, result, 0, this->height);
+
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        std::atomic<unsigned int> counter(0);
+        for (unsigned int i = 0; i < thread_num; i++) {
+            threads.emplace_back([this, &left, &right, &result, &counter] () {
+                while (true) {
+                    unsigned int row_l = counter++;
+                    if (row_l >= this->height) {
+                        break;
+                    }
+
+                    this->executeRows(left, right, result, row_l, row_l + 1);
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+
+private:
+    static bool matches(
+        const std::shared_ptr<const SparsityPattern>& pattern,
+        const std::shared_ptr<const SparsityPattern>& planned
+    ) {
+        return pattern == planned || *pattern == *planned;
+    }
+
+    void executeRows(
+        const MatrixType& left,
+        const MatrixType& right,
+        MatrixType& result,
+        unsigned int rowBeg,
+        unsigned int rowEnd
+    ) const {
+        const auto& offsets_l = this->leftPattern->offsets;
+        const auto& columnIndices_l = this->leftPattern->columnIndices;
+        const auto& offsets_r = this->rightPattern->offsets;
+        const auto& offsets = this->resultPattern->offsets;
+        std::fill(result.values.begin() + offsets[rowBeg], result.values.begin() + offsets[rowEnd], static_cast<T>(0));
+
+        auto term = this->termOffsets[rowBeg];
+        for (auto row_l = rowBeg; row_l < rowEnd; row_l++) {
+            for (auto i_l = offsets_l[row_l]; i_l < offsets_l[row_l + 1]; ++i_l) {
+                auto row_r = columnIndices_l[i_l];
+                auto value_l = left.values[i_l];
+                for (auto i_r = offsets_r[row_r]; i_r < offsets_r[row_r + 1]; ++i_r) {
+                    result.values[this->scatterMap[term++]] += value_l * right.values[i_r];
+                }
+            }
+        }
+    }
+};
+}
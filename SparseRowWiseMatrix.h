@@ -1,18 +1,37 @@
 #pragma once
 
+#include "Executor.h"
 #include "NumericTypeConcept.h"
+#include "Pruning.h"
 #include "RowQueue.h"
+#include "Semiring.h"
+#include "SparseRowWiseMatrixView.h"
+#include "SparsityPattern.h"
 #include "Triplet.h"
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace Barta {
 
+enum class TransposedProductStrategy {
+    Automatic,
+    PrivateBuffers, // every thread scatters to its own vector, the vectors are summed in a tree
+    Atomics         // all threads scatter to one vector with atomic additions
+};
+
 template<NumericType T>
 class SparseRowWiseMatrix {
     public:
@@ -20,12 +39,12 @@ class SparseRowWiseMatrix {
     unsigned int height;
 
     std::vector<T> values;
-    std::vector<unsigned int> columnIndices;
-    std::vector<unsigned int> offsets;
+    std::shared_ptr<const SparsityPattern> pattern;
 
 public:
     using VectorType = std::vector<T>;
     using TripletType = Triplet<T>;
+    using ViewType = SparseRowWiseMatrixView<T>;
 
     SparseRowWiseMatrix(
         unsigned int width,
@@ -33,7 +52,26 @@ public:
     ):
         width(width),
         height(height),
-        offsets(height + 1, 0) {}
+        pattern(std::make_shared<const SparsityPattern>(height)) {}
+
+    SparseRowWiseMatrix(
+        unsigned int width,
+        unsigned int height,
+        std::shared_ptr<const SparsityPattern> pattern,
+        std::vector<T> values
+    ):
+        width(width),
+        height(height),
+        values(std::move(values)),
+        pattern(std::move(pattern)) {
+        if (this->pattern->offsets.size() != this->height + 1) {
+            throw std::runtime_error("pattern height does not match the matrix height!");
+        }
+
+        if (this->pattern->columnIndices.size() != this->values.size()) {
+            throw std::runtime_error("number of values does not match the pattern!");
+        }
+    }
 
     SparseRowWiseMatrix(
         unsigned int width,
@@ -42,7 +80,8 @@ public:
         bool sorted = false,
         bool merged = false
     ):
-        SparseRowWiseMatrix(width, height) {
+        width(width),
+        height(height) {
         if (!sorted) {
             TripletType::sort(triplets);
         }
@@ -54,29 +93,20 @@ public:
             mergedTriplets = std::move(triplets);
         }
 
+        SparsityPattern pattern(this->height);
         this->values.resize(mergedTriplets.size(), static_cast<T>(0));
-        this->columnIndices.resize(mergedTriplets.size(), static_cast<T>(0));
-        auto rowSizes = std::vector<std::size_t>(this->height);
+        pattern.columnIndices.resize(mergedTriplets.size(), 0);
         unsigned int i = 0;
         for (const auto triplet: mergedTriplets) {
             this->values[i] = triplet.val;
-            this->columnIndices[i] = triplet.col;
-            ++this->offsets[triplet.row];
+            pattern.columnIndices[i] = triplet.col;
+            ++pattern.offsets[triplet.row];
 
             i++;
         }
 
-        unsigned int savedOffset = this->values.size();
-        for (unsigned int i = this->offsets.size() - 1; i >= 1; i--) {
-            this->offsets[i] = savedOffset;
-            savedOffset -= this->offsets[i - 1];
-        }
-
-        this->offsets[0] = savedOffset;
-
-        if (savedOffset != 0) {
-            throw std::runtime_error("offset is different than 0!");
-        }
+        SparseRowWiseMatrix::accumulateOffsets(pattern.offsets, this->values.size());
+        this->pattern = std::make_shared<const SparsityPattern>(std::move(pattern));
     }
 
     SparseRowWiseMatrix(
@@ -84,37 +114,72 @@ public:
         unsigned int height,
         std::vector<std::vector<TripletType>> vectorOfTriplets // assumption: sorted and merged
     ):
-        SparseRowWiseMatrix(width, height) {
+        width(width),
+        height(height) {
         size_t nnz = 0;
         for (const auto& triplets: vectorOfTriplets) {
             nnz += triplets.size();
         }
 
+        SparsityPattern pattern(this->height);
         this->values.resize(nnz, static_cast<T>(0));
-        this->columnIndices.resize(nnz, static_cast<T>(0));
-        auto rowSizes = std::vector<std::size_t>(this->height);
+        pattern.columnIndices.resize(nnz, 0);
         unsigned int i = 0;
         for (const auto& triplets: vectorOfTriplets) {
             for (const auto triplet: triplets) {
                 this->values[i] = triplet.val;
-                this->columnIndices[i] = triplet.col;
-                ++this->offsets[triplet.row];
+                pattern.columnIndices[i] = triplet.col;
+                ++pattern.offsets[triplet.row];
 
                 i++;
             }
         }
 
-        unsigned int savedOffset = this->values.size();
-        for (unsigned int i = this->offsets.size() - 1; i >= 1; i--) {
-            this->offsets[i] = savedOffset;
-            savedOffset -= this->offsets[i - 1];
-        }
+        SparseRowWiseMatrix::accumulateOffsets(pattern.offsets, this->values.size());
+        this->pattern = std::make_shared<const SparsityPattern>(std::move(pattern));
+    }
 
-        this->offsets[0] = savedOffset;
+    const std::shared_ptr<const SparsityPattern>& getPattern() const { return this->pattern; }
 
-        if (savedOffset != 0) {
-            throw std::runtime_error("offset is different than 0!");
+    const std::vector<unsigned int>& getColumnIndices() const { return this->pattern->columnIndices; }
+
+    const std::vector<unsigned int>& getOffsets() const { return this->pattern->offsets; }
+
+    ViewType view() const { return ViewType(this->width, this->values, this->pattern->columnIndices, this->pattern->offsets); }
+
+    // rows [rowBeg, rowEnd) without copying
+    ViewType rowView(
+        unsigned int rowBeg,
+        unsigned int rowEnd
+    ) const {
+        return this->view().rows(rowBeg, rowEnd);
+    }
+
+    SparseRowWiseMatrix extractSubmatrix(
+        unsigned int rowBeg,
+        unsigned int rowEnd,
+        unsigned int colBeg,
+        unsigned int colEnd,
+        unsigned int thread_num
+    ) const {
+        return this->view().extractSubmatrix(rowBeg, rowEnd, colBeg, colEnd, thread_num);
+    }
+
+    double emptyRowRatio() const {
+        const auto& offsets = this->pattern->offsets;
+        unsigned int emptyRows = 0;
+        for (unsigned int row = 0; row < this->height; row++) {
+            emptyRows += offsets[row + 1] == offsets[row];
         }
+
+        return this->height == 0 ? 0. : static_cast<double>(emptyRows) / this->height;
+    }
+
+    bool sharesPatternWith(const SparseRowWiseMatrix& other) const { return this->pattern == other.pattern; }
+
+    // new matrix with the same structure, e.g. the next time step of a system with a fixed sparsity
+    SparseRowWiseMatrix withValues(std::vector<T> values) const {
+        return SparseRowWiseMatrix(this->width, this->height, this->pattern, std::move(values));
     }
 
     void insert(
@@ -122,25 +187,30 @@ public:
         unsigned int col,
         T value
     ) {
+        const auto& offsets = this->pattern->offsets;
+        const auto& columnIndices = this->pattern->columnIndices;
         unsigned int newPos;
-        for (newPos = this->offsets[row]; newPos < this->offsets[row + 1]; newPos++) {
-            if (col == this->columnIndices[newPos]) {
+        for (newPos = offsets[row]; newPos < offsets[row + 1]; newPos++) {
+            if (col == columnIndices[newPos]) {
                 this->values[newPos] = value;
 
                 return;
             }
 
-            if (col < this->columnIndices[newPos]) {
+            if (col < columnIndices[newPos]) {
                 break;
             }
         }
 
-        for (size_t i = row + 1; i < this->offsets.size(); i++) {
-            this->offsets[i]++;
+        // the pattern may be shared with other matrices, so a new one is created (copy on write)
+        auto pattern = std::make_shared<SparsityPattern>(*this->pattern);
+        for (size_t i = row + 1; i < pattern->offsets.size(); i++) {
+            pattern->offsets[i]++;
         }
 
-        this->columnIndices.insert(this->columnIndices.begin() + newPos, col);
+        pattern->columnIndices.insert(pattern->columnIndices.begin() + newPos, col);
         this->values.insert(this->values.begin() + newPos, value);
+        this->pattern = std::move(pattern);
     }
 
     VectorType operator*(
@@ -148,20 +218,152 @@ public:
     ) const {
         assert(this->height == v.size());
 
+        const auto& offsets = this->pattern->offsets;
+        const auto& columnIndices = this->pattern->columnIndices;
         auto ret = VectorType(v.size(), static_cast<T>(0));
         auto row = 0;
         for (int i = 0; i < this->values.size(); i++) {
-            while (this->offsets[row + 1] <= i) {
+            while (offsets[row + 1] <= i) {
                 row++;
             }
 
-            ret[row] += this->values[i] * v[this->columnIndices[i]];
+            ret[row] += this->values[i] * v[columnIndices[i]];
+        }
+
+        return ret;
+    }
+
+    // SpMV in the semiring S, e.g. multiply<MinPlus<T>>(distances) relaxes all edges once
+    template<Semiring<T> S>
+    VectorType multiply(
+        const VectorType& v
+    ) const {
+        assert(this->width == v.size());
+
+        const auto& offsets = this->pattern->offsets;
+        const auto& columnIndices = this->pattern->columnIndices;
+        auto ret = VectorType(this->height, S::zero());
+        for (unsigned int row = 0; row < this->height; row++) {
+            T value = S::zero();
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                value = S::add(value, S::multiply(this->values[i], v[columnIndices[i]]));
+            }
+
+            ret[row] = value;
+        }
+
+        return ret;
+    }
+
+    // Boolean SpMV over bit-packed vectors (bit j of v is v[j / 64] >> j % 64): bit i of the result is set when
+    // row i has a nonzero in a column whose bit is set in v. The inner loop is branch-free.
+    std::vector<std::uint64_t> multiplyBitPacked(
+        const std::vector<std::uint64_t>& v
+    ) const {
+        assert((this->width + 63) / 64 == v.size());
+
+        const auto& offsets = this->pattern->offsets;
+        const auto& columnIndices = this->pattern->columnIndices;
+        std::vector<std::uint64_t> ret((this->height + 63) / 64, 0);
+        for (unsigned int row = 0; row < this->height; row++) {
+            std::uint64_t bit = 0;
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                auto col = columnIndices[i];
+                bit |= (v[col >> 6] >> (col & 63)) & static_cast<std::uint64_t>(this->values[i] != static_cast<T>(0));
+            }
+
+            ret[row >> 6] |= bit << (row & 63);
         }
 
         return ret;
     }
 
+    // A^T v scattered from the row-wise arrays, without materializing the transpose. Automatic uses private
+    // buffers when they are small compared to the matrix, atomics otherwise. Building the transpose costs about
+    // as much as a few scattered products, so for many products with the same values multiply transposed() instead.
+    VectorType multiplyTransposed(
+        const VectorType& v,
+        unsigned int thread_num,
+        TransposedProductStrategy strategy = TransposedProductStrategy::Automatic
+    ) const {
+        assert(this->height == v.size());
+
+        if (strategy == TransposedProductStrategy::Automatic) {
+            if (static_cast<size_t>(this->width) * thread_num <= this->values.size()) {
+                strategy = TransposedProductStrategy::PrivateBuffers;
+            } else {
+                strategy = TransposedProductStrategy::Atomics;
+            }
+        }
+
+        if (thread_num <= 1) {
+            auto ret = VectorType(this->width, static_cast<T>(0));
+            this->scatterTransposed(v, 0, this->height, ret.data());
+
+            return ret;
+        }
+
+        auto rowBlocks = this->pattern->balancedRowBlocks(thread_num);
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        if (strategy == TransposedProductStrategy::Atomics) {
+            auto ret = VectorType(this->width, static_cast<T>(0));
+            for (unsigned int t = 0; t < thread_num; t++) {
+                threads.emplace_back([this, &v, &rowBlocks, &ret, t] () {
+                    const auto& offsets = this->pattern->offsets;
+                    const auto& columnIndices = this->pattern->columnIndices;
+                    for (auto row = rowBlocks[t]; row < rowBlocks[t + 1]; row++) {
+                        auto v_row = v[row];
+                        for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                            std::atomic_ref<T>(ret[columnIndices[i]]).fetch_add(this->values[i] * v_row, std::memory_order_relaxed);
+                        }
+                    }
+                });
+            }
+
+            for (auto& thread: threads) {
+                thread.join();
+            }
+
+            return ret;
+        }
+
+        std::vector<VectorType> buffers(thread_num);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([this, &v, &rowBlocks, &buffers, t] () {
+                buffers[t].assign(this->width, static_cast<T>(0));
+                this->scatterTransposed(v, rowBlocks[t], rowBlocks[t + 1], buffers[t].data());
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        for (unsigned int step = 1; step < thread_num; step *= 2) {
+            threads.clear();
+            for (unsigned int t = 0; t + step < thread_num; t += 2 * step) {
+                threads.emplace_back([&buffers, t, step] () {
+                    auto& target = buffers[t];
+                    const auto& source = buffers[t + step];
+                    for (size_t i = 0; i < target.size(); i++) {
+                        target[i] += source[i];
+                    }
+                });
+            }
+
+            for (auto& thread: threads) {
+                thread.join();
+            }
+        }
+
+        return std::move(buffers[0]);
+    }
+
     std::string toString() const {
+        const auto& offsets = this->pattern->offsets;
+        const auto& columnIndices = this->pattern->columnIndices;
         std::stringstream ss;
         constexpr unsigned int w = 6;
         ss << "[" << std::endl;
@@ -169,7 +371,7 @@ public:
         for (int i = 0; i < this->height; i++) {
             for (int j = 0; j < this->width; j++) {
                 ss << std::setw(w);
-                if (this->offsets[i + 1] > cursor && this->columnIndices[cursor] == j) {
+                if (offsets[i + 1] > cursor && columnIndices[cursor] == j) {
                     ss << this->values[cursor];
                     cursor++;
                 } else {
@@ -190,20 +392,24 @@ public:
     SparseRowWiseMatrix multiplyInner(
         const SparseRowWiseMatrix& other
     ) const {
+        const auto& offsets_l = this->pattern->offsets;
+        const auto& columnIndices_l = this->pattern->columnIndices;
+        const auto& offsets_r = other.pattern->offsets;
+        const auto& columnIndices_r = other.pattern->columnIndices;
         std::vector<TripletType> triplets = {};
         triplets.reserve(std::max(this->values.size(), other.values.size()));
-        for (int row_l = 0; row_l < this->offsets.size() - 1; row_l++) {
+        for (int row_l = 0; row_l < this->height; row_l++) {
             // if (row_l % (this->height / 100) == 0) {
             //     std::cout << "calculating row " << row_l << std::endl;
             // }
 
             for (int col_r = 0; col_r < other.width; col_r++) {
                 T value = static_cast<T>(0);
-                for (int i_l = this->offsets[row_l]; i_l < this->offsets[row_l + 1]; ++i_l) {
-                    auto col_l = this->columnIndices[i_l];
+                for (int i_l = offsets_l[row_l]; i_l < offsets_l[row_l + 1]; ++i_l) {
+                    auto col_l = columnIndices_l[i_l];
                     auto row_r = col_l;
-                    for (int i_r = other.offsets[row_r]; i_r < other.offsets[row_r + 1]; ++i_r) {
-                        if (other.columnIndices[i_r] == col_r) {
+                    for (int i_r = offsets_r[row_r]; i_r < offsets_r[row_r + 1]; ++i_r) {
+                        if (columnIndices_r[i_r] == col_r) {
                             value += this->values[i_l] * other.values[i_r];
 
                             break;
@@ -221,34 +427,36 @@ public:
     }
 
 
+    SparseRowWiseMatrix transposed() const { return this->view().transposed(); }
+
+    template<Semiring<T> S = PlusTimes<T>>
     SparseRowWiseMatrix multiplyInnerWithTransposition(
         const SparseRowWiseMatrix& other,
-        unsigned int thread_num
+        unsigned int thread_num,
+        const Pruning<T>& pruning = {}
     ) const {
-        std::vector<TripletType> triplets = {};
-        triplets.reserve(other.values.size());
-        int row = 0;
-        for (int i = 0; i < other.values.size(); i++) {
-            while (other.offsets[row + 1] <= i) {
-                ++row;
-            }
-
-            triplets.emplace_back(other.columnIndices[i], row, other.values[i]);
-        }
+        return this->multiplyInnerWithTransposition<S>(other.view(), thread_num, pruning);
+    }
 
-        SparseRowWiseMatrix transposedOther(other.height, other.width, std::move(triplets), false, true);
+    template<Semiring<T> S = PlusTimes<T>>
+    SparseRowWiseMatrix multiplyInnerWithTransposition(
+        const ViewType& other,
+        unsigned int thread_num,
+        const Pruning<T>& pruning = {}
+    ) const {
+        SparseRowWiseMatrix transposedOther = other.transposed();
 
-        std::vector<std::vector<TripletType>> vectorOfTriplets(this->offsets.size() - 1);
+        std::vector<std::vector<TripletType>> vectorOfTriplets(this->height);
 
         std::vector<std::thread> threads;
         threads.reserve(thread_num + 1);
         std::atomic<int> counter(0);
         for (int i = 0; i < thread_num; i++) {
             threads.emplace_back(
-                [this, &transposedOther, &counter, &vectorOfTriplets] () {
+                [this, &transposedOther, &pruning, &counter, &vectorOfTriplets] () {
                     while (true) {
                         int row_l = counter++;
-                        if (row_l > this->height) {
+                        if (row_l >= this->height) {
                             break;
                         }
 
@@ -256,27 +464,7 @@ public:
                         //     std::cout << "calculating row " << row_l << std::endl;
                         // }
 
-                        vectorOfTriplets[row_l].reserve(std::sqrt(this->height)); // TODO dynamic memory size
-                        for (int row_r = 0; row_r < transposedOther.height; row_r++) {
-                            auto i_l = this->offsets[row_l];
-                            auto i_r = transposedOther.offsets[row_r];
-                            T value = static_cast<T>(0);
-                            while (i_l < this->offsets[row_l + 1] && i_r < transposedOther.offsets[row_r + 1]) {
-                                if (this->columnIndices[i_l] < transposedOther.columnIndices[i_r]) {
-                                    ++i_l;
-                                } else if (this->columnIndices[i_l] > transposedOther.columnIndices[i_r]) {
-                                    ++i_r;
-                                } else {
-                                    value += this->values[i_l] * transposedOther.values[i_r];
-                                    ++i_l;
-                                    ++i_r;
-                                }
-                            }
-
-                            if (value != static_cast<T>(0)) {
-                                vectorOfTriplets[row_l].emplace_back(row_l, row_r, value);
-                            }
-                        }
+                        this->multiplyRowInner<S>(row_l, transposedOther, pruning, vectorOfTriplets[row_l]);
                     }
                 }
             );
@@ -289,63 +477,196 @@ public:
         return SparseRowWiseMatrix(other.width, this->height, std::move(vectorOfTriplets));
     }
 
-    SparseRowWiseMatrix multiplyRowWise(
+    // Asynchronous version running on a shared executor; both operands have to outlive the returned future.
+    template<Semiring<T> S = PlusTimes<T>>
+    std::future<SparseRowWiseMatrix> multiplyInnerWithTranspositionAsync(
         const SparseRowWiseMatrix& other,
-        const unsigned int initialQueueCapacity,
-        const unsigned int thread_num
+        Executor& executor = Executor::shared(),
+        const Pruning<T>& pruning = {}
     ) const {
-        std::vector<std::vector<TripletType>> vectorOfTriplets(this->offsets.size() - 1);
+        auto promise = std::make_shared<std::promise<SparseRowWiseMatrix>>();
+        auto future = promise->get_future();
+        auto transposedOther = std::make_shared<SparseRowWiseMatrix>(other.width, other.height);
+        executor.submit(
+            1,
+            [&other, transposedOther] (unsigned int) { *transposedOther = other.transposed(); },
+            [this, &other, &executor, pruning, promise, transposedOther] (std::exception_ptr error) {
+                if (error != nullptr) {
+                    promise->set_exception(error);
+
+                    return;
+                }
 
-        std::vector<std::thread> threads;
-        threads.reserve(thread_num + 1);
-        std::atomic<int> counter(0);
-        for (int i = 0; i < thread_num; i++) {
-            threads.emplace_back(
-                [this, &other, initialQueueCapacity, &counter, &vectorOfTriplets] () {
-                    while (true) {
-                        int row_l = counter++;
-                        if (row_l > this->height) {
-                            break;
+                auto rowBlocks = this->pattern->balancedRowBlocks(SparseRowWiseMatrix::asyncChunkCount(executor));
+                auto vectorOfTriplets = std::make_shared<std::vector<std::vector<TripletType>>>(this->height);
+                executor.submit(
+                    rowBlocks.size() - 1,
+                    [this, rowBlocks, transposedOther, pruning, vectorOfTriplets] (unsigned int chunk) {
+                        for (auto row_l = rowBlocks[chunk]; row_l < rowBlocks[chunk + 1]; row_l++) {
+                            this->template multiplyRowInner<S>(row_l, *transposedOther, pruning, (*vectorOfTriplets)[row_l]);
+                        }
+                    },
+                    [this, &other, promise, vectorOfTriplets] (std::exception_ptr error) {
+                        if (error != nullptr) {
+                            promise->set_exception(error);
+                        } else {
+                            promise->set_value(SparseRowWiseMatrix(other.width, this->height, std::move(*vectorOfTriplets)));
                         }
+                    }
+                );
+            }
+        );
 
-                        // if (row_l % (this->height / 100) == 0) {
-                        //     std::cout << "calculating row " << row_l << std::endl;
-                        // }
+        return future;
+    }
 
-                        RowQueue<T> queue = {initialQueueCapacity};
-                        for (int i_l = this->offsets[row_l]; i_l < this->offsets[row_l + 1]; ++i_l) {
-                            auto row_r = this->columnIndices[i_l];
-                            auto value_l = this->values[i_l];
-                            for (int i_r = other.offsets[row_r]; i_r < other.offsets[row_r + 1]; ++i_r) {
-                                queue.push(value_l * other.values[i_r], other.columnIndices[i_r]);
-                            }
-                        }
+    template<Semiring<T> S = PlusTimes<T>>
+    SparseRowWiseMatrix multiplyRowWise(
+        const SparseRowWiseMatrix& other,
+        const unsigned int initialQueueCapacity,
+        const unsigned int thread_num,
+        const Pruning<T>& pruning = {}
+    ) const {
+        return this->view().template multiplyRowWise<S>(other.view(), initialQueueCapacity, thread_num, pruning);
+    }
 
-                        if (queue.size() < 1) {
-                            return;
-                        }
+    template<Semiring<T> S = PlusTimes<T>>
+    SparseRowWiseMatrix multiplyRowWise(
+        const ViewType& other,
+        const unsigned int initialQueueCapacity,
+        const unsigned int thread_num,
+        const Pruning<T>& pruning = {}
+    ) const {
+        return this->view().template multiplyRowWise<S>(other, initialQueueCapacity, thread_num, pruning);
+    }
 
-                        queue.mergeAll();
-                        auto& elements = queue.getElements();
-                        vectorOfTriplets[row_l].resize(elements.size());
-                        int i = queue.getQueueBeg()[0];
-                        int j = 0;
-                        while (i != -1) {
-                            vectorOfTriplets[row_l][j] = {row_l, elements[i].col, elements[i].value};
+    // Asynchronous version running on a shared executor; both operands have to outlive the returned future.
+    template<Semiring<T> S = PlusTimes<T>>
+    std::future<SparseRowWiseMatrix> multiplyRowWiseAsync(
+        const SparseRowWiseMatrix& other,
+        const unsigned int initialQueueCapacity,
+        Executor& executor = Executor::shared(),
+        const Pruning<T>& pruning = {}
+    ) const {
+        auto rowBlocks = this->pattern->balancedRowBlocks(SparseRowWiseMatrix::asyncChunkCount(executor));
+        auto vectorOfTriplets = std::make_shared<std::vector<std::vector<TripletType>>>(this->height);
+
+        return executor.submit<SparseRowWiseMatrix>(
+            rowBlocks.size() - 1,
+            [this, otherView = other.view(), initialQueueCapacity, pruning, rowBlocks, vectorOfTriplets] (unsigned int chunk) {
+                const auto& offsets_l = this->pattern->offsets;
+                const auto& columnIndices_l = this->pattern->columnIndices;
+                for (auto row_l = rowBlocks[chunk]; row_l < rowBlocks[chunk + 1]; row_l++) {
+                    auto beg = offsets_l[row_l];
+                    SparseRowWiseMatrix::multiplyRowRowWise<S>(
+                        row_l,
+                        this->values.data() + beg,
+                        columnIndices_l.data() + beg,
+                        offsets_l[row_l + 1] - beg,
+                        otherView,
+                        initialQueueCapacity,
+                        (*vectorOfTriplets)[row_l],
+                        pruning
+                    );
+                }
+            },
+            [this, &other, vectorOfTriplets] () { return SparseRowWiseMatrix(other.width, this->height, std::move(*vectorOfTriplets)); }
+        );
+    }
 
-                            ++j;
-                            i = elements[i].next;
-                        }
+    // Row row_l of the row-wise product of a left matrix and other, given the entries of that left row.
+    // The resulting sorted and merged entries are pruned and written to triplets.
+    template<Semiring<T> S = PlusTimes<T>>
+    static void multiplyRowRowWise(
+        unsigned int row_l,
+        const T* values_l,
+        const unsigned int* columnIndices_l,
+        unsigned int rowLength,
+        const ViewType& other,
+        unsigned int initialQueueCapacity,
+        std::vector<TripletType>& triplets,
+        const Pruning<T>& pruning = {}
+    ) {
+        SparseRowWiseMatrix::multiplyRowRowWise<S>(
+            row_l,
+            values_l,
+            columnIndices_l,
+            rowLength,
+            other.values.data(),
+            other.columnIndices.data(),
+            [&other] (unsigned int row_r) { return std::pair<unsigned int, unsigned int>(other.offsets[row_r], other.offsets[row_r + 1]); },
+            initialQueueCapacity,
+            triplets,
+            pruning
+        );
+    }
+
+    // The same for a right matrix in any row-wise layout: rowRange(row_r) returns the range [beg, end) of the
+    // entries of row row_r in values_r and columnIndices_r, an empty range for an empty row.
+    template<Semiring<T> S, typename RowRange>
+    static void multiplyRowRowWise(
+        unsigned int row_l,
+        const T* values_l,
+        const unsigned int* columnIndices_l,
+        unsigned int rowLength,
+        const T* values_r,
+        const unsigned int* columnIndices_r,
+        RowRange rowRange,
+        unsigned int initialQueueCapacity,
+        std::vector<TripletType>& triplets,
+        const Pruning<T>& pruning
+    ) {
+        if constexpr (S::isBoolean) {
+            // only the union of the reached columns is needed, which is cheaper than merging values
+            for (unsigned int i_l = 0; i_l < rowLength; ++i_l) {
+                if (values_l[i_l] == S::zero()) {
+                    continue;
+                }
+
+                auto [beg_r, end_r] = rowRange(columnIndices_l[i_l]);
+                for (auto i_r = beg_r; i_r < end_r; ++i_r) {
+                    if (values_r[i_r] != S::zero()) {
+                        triplets.emplace_back(row_l, columnIndices_r[i_r], static_cast<T>(1));
                     }
                 }
+            }
+
+            std::sort(triplets.begin(), triplets.end(), [](const TripletType& l, const TripletType& r) { return l.col < r.col; });
+            triplets.erase(
+                std::unique(triplets.begin(), triplets.end(), [](const TripletType& l, const TripletType& r) { return l.col == r.col; }),
+                triplets.end()
             );
+            pruning.apply(triplets);
+
+            return;
         }
 
-        for (int i = 0; i < thread_num; i++) {
-            threads[i].join();
+        RowQueue<T, S> queue = {initialQueueCapacity};
+        for (unsigned int i_l = 0; i_l < rowLength; ++i_l) {
+            auto value_l = values_l[i_l];
+            auto [beg_r, end_r] = rowRange(columnIndices_l[i_l]);
+            for (auto i_r = beg_r; i_r < end_r; ++i_r) {
+                queue.push(S::multiply(value_l, values_r[i_r]), columnIndices_r[i_r]);
+            }
+        }
+
+        if (queue.size() < 1) {
+            return;
+        }
+
+        queue.mergeAll();
+        auto& elements = queue.getElements();
+        triplets.resize(elements.size());
+        int i = queue.getQueueBeg()[0];
+        int j = 0;
+        while (i != -1) {
+            triplets[j] = {row_l, elements[i].col, elements[i].value};
+
+            ++j;
+            i = elements[i].next;
         }
 
-        return SparseRowWiseMatrix(other.width, this->height, vectorOfTriplets);
+        pruning.apply(triplets);
     }
 
     bool operator==(const SparseRowWiseMatrix & other) const {
@@ -353,11 +674,15 @@ public:
             return false;
         }
 
-        if (this->columnIndices.size() != other.columnIndices.size()) {
+        const auto& columnIndices = this->pattern->columnIndices;
+        const auto& offsets = this->pattern->offsets;
+        const auto& otherColumnIndices = other.pattern->columnIndices;
+        const auto& otherOffsets = other.pattern->offsets;
+        if (columnIndices.size() != otherColumnIndices.size()) {
             return false;
         }
 
-        if (this->offsets.size() != other.offsets.size()) {
+        if (offsets.size() != otherOffsets.size()) {
             return false;
         }
 
@@ -369,15 +694,19 @@ public:
             }
         }
 
-        for (int i = 0; i < this->columnIndices.size(); ++i) {
-            if (this->columnIndices[i] != other.columnIndices[i]) {
+        if (this->sharesPatternWith(other)) {
+            return true;
+        }
+
+        for (int i = 0; i < columnIndices.size(); ++i) {
+            if (columnIndices[i] != otherColumnIndices[i]) {
             std::cout << "XD5 " << i << std::endl;
                 return false;
             }
         }
 
-        for (int i = 0; i < this->offsets.size(); ++i) {
-            if (this->offsets[i] != other.offsets[i]) {
+        for (int i = 0; i < offsets.size(); ++i) {
+            if (offsets[i] != otherOffsets[i]) {
             std::cout << "XD6 " << i << std::endl;
                 return false;
             }
@@ -385,6 +714,85 @@ public:
 
         return true;
     }
+
+private:
+    void scatterTransposed(
+        const VectorType& v,
+        unsigned int rowBeg,
+        unsigned int rowEnd,
+        T* ret
+    ) const {
+        const auto& offsets = this->pattern->offsets;
+        const auto& columnIndices = this->pattern->columnIndices;
+        for (auto row = rowBeg; row < rowEnd; row++) {
+            auto v_row = v[row];
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                ret[columnIndices[i]] += this->values[i] * v_row;
+            }
+        }
+    }
+
+    // a few chunks per worker, so that uneven rows and concurrent jobs still balance
+    static unsigned int asyncChunkCount(
+        const Executor& executor
+    ) {
+        return 4 * executor.size();
+    }
+
+    // row row_l of the inner product with the already transposed right matrix
+    template<Semiring<T> S>
+    void multiplyRowInner(
+        unsigned int row_l,
+        const SparseRowWiseMatrix& transposedOther,
+        const Pruning<T>& pruning,
+        std::vector<TripletType>& triplets
+    ) const {
+        const auto& offsets_l = this->pattern->offsets;
+        const auto& columnIndices_l = this->pattern->columnIndices;
+        const auto& offsets_r = transposedOther.pattern->offsets;
+        const auto& columnIndices_r = transposedOther.pattern->columnIndices;
+        triplets.reserve(std::sqrt(this->height)); // TODO dynamic memory size
+        for (unsigned int row_r = 0; row_r < transposedOther.height; row_r++) {
+            auto i_l = offsets_l[row_l];
+            auto i_r = offsets_r[row_r];
+            T value = S::zero();
+            while (i_l < offsets_l[row_l + 1] && i_r < offsets_r[row_r + 1]) {
+                if (columnIndices_l[i_l] < columnIndices_r[i_r]) {
+                    ++i_l;
+                } else if (columnIndices_l[i_l] > columnIndices_r[i_r]) {
+                    ++i_r;
+                } else {
+                    value = S::add(value, S::multiply(this->values[i_l], transposedOther.values[i_r]));
+                    ++i_l;
+                    ++i_r;
+                }
+            }
+
+            if (value != S::zero()) {
+                triplets.emplace_back(row_l, row_r, value);
+            }
+        }
+
+        pruning.apply(triplets);
+    }
+
+    // turns per row counts into offsets
+    static void accumulateOffsets(
+        std::vector<unsigned int>& offsets,
+        unsigned int nnz
+    ) {
+        unsigned int savedOffset = nnz;
+        for (unsigned int i = offsets.size() - 1; i >= 1; i--) {
+            offsets[i] = savedOffset;
+            savedOffset -= offsets[i - 1];
+        }
+
+        offsets[0] = savedOffset;
+
+        if (savedOffset != 0) {
+            throw std::runtime_error("offset is different than 0!");
+        }
+    }
 };
 
 template<NumericType T>
@@ -392,13 +800,15 @@ std::ostream& operator<<(
     std::ostream& s,
     const SparseRowWiseMatrix<T>& mat
 ) {
+    const auto& offsets = mat.getOffsets();
+    const auto& columnIndices = mat.getColumnIndices();
     constexpr const unsigned int w = 6;
     s << "[";
     unsigned int cursor = 0;
     for (int i = 0; i < mat.height; i++) {
         for (int j = 0; j < mat.width; j++) {
             s << std::setw(w);
-            if (mat.offsets[i + 1] > cursor && mat.columnIndices[cursor] == j) {
+            if (offsets[i + 1] > cursor && columnIndices[cursor] == j) {
                 s << mat.values[cursor];
                 cursor++;
             } else {
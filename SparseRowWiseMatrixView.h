@@ -0,0 +1,205 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "Pruning.h"
+#include "Semiring.h"
+#include "SparsityPattern.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+template<NumericType T>
+class SparseRowWiseMatrix;
+
+// Non-owning view of a block of consecutive rows of a SparseRowWiseMatrix. It points into the arrays of the
+// matrix without copying them, so the matrix has to outlive the view.
+// offsets has height + 1 elements and indexes values and columnIndices of the whole matrix.
+template<NumericType T>
+class SparseRowWiseMatrixView {
+public:
+    using VectorType = std::vector<T>;
+    using TripletType = Triplet<T>;
+    using MatrixType = SparseRowWiseMatrix<T>;
+
+    unsigned int width;
+    unsigned int height;
+
+    std::span<const T> values;
+    std::span<const unsigned int> columnIndices;
+    std::span<const unsigned int> offsets;
+
+    SparseRowWiseMatrixView(
+        unsigned int width,
+        std::span<const T> values,
+        std::span<const unsigned int> columnIndices,
+        std::span<const unsigned int> offsets
+    ):
+        width(width),
+        height(offsets.size() - 1),
+        values(values),
+        columnIndices(columnIndices),
+        offsets(offsets) {}
+
+    SparseRowWiseMatrixView rows(
+        unsigned int rowBeg,
+        unsigned int rowEnd
+    ) const {
+        assert(rowBeg <= rowEnd && rowEnd <= this->height);
+
+        return SparseRowWiseMatrixView(this->width, this->values, this->columnIndices, this->offsets.subspan(rowBeg, rowEnd - rowBeg + 1));
+    }
+
+    size_t nonZeros() const { return this->offsets[this->height] - this->offsets[0]; }
+
+    VectorType operator*(
+        const VectorType& v
+    ) const {
+        return this->multiply<PlusTimes<T>>(v);
+    }
+
+    template<Semiring<T> S>
+    VectorType multiply(
+        const VectorType& v
+    ) const {
+        assert(this->width == v.size());
+
+        auto ret = VectorType(this->height, S::zero());
+        for (unsigned int row = 0; row < this->height; row++) {
+            T value = S::zero();
+            for (auto i = this->offsets[row]; i < this->offsets[row + 1]; i++) {
+                value = S::add(value, S::multiply(this->values[i], v[this->columnIndices[i]]));
+            }
+
+            ret[row] = value;
+        }
+
+        return ret;
+    }
+
+    // Copy of the rows [rowBeg, rowEnd) restricted to the columns [colBeg, colEnd). The columns of a row are
+    // sorted, so a first parallel pass finds the kept range of every row by a binary search, the offsets are
+    // accumulated sequentially and a second parallel pass copies the ranges.
+    MatrixType extractSubmatrix(
+        unsigned int rowBeg,
+        unsigned int rowEnd,
+        unsigned int colBeg,
+        unsigned int colEnd,
+        unsigned int thread_num
+    ) const {
+        assert(rowBeg <= rowEnd && rowEnd <= this->height && colBeg <= colEnd && colEnd <= this->width);
+
+        auto height = rowEnd - rowBeg;
+        std::vector<unsigned int> ranges(2 * height);
+        SparseRowWiseMatrixView::runOnRowBlocks(height, thread_num, [this, rowBeg, colBeg, colEnd, &ranges] (unsigned int row) {
+            auto beg = this->columnIndices.begin() + this->offsets[rowBeg + row];
+            auto end = this->columnIndices.begin() + this->offsets[rowBeg + row + 1];
+            ranges[2 * row] = std::lower_bound(beg, end, colBeg) - this->columnIndices.begin();
+            ranges[2 * row + 1] = std::lower_bound(beg, end, colEnd) - this->columnIndices.begin();
+        });
+
+        SparsityPattern pattern(height);
+        for (unsigned int row = 0; row < height; row++) {
+            pattern.offsets[row + 1] = pattern.offsets[row] + ranges[2 * row + 1] - ranges[2 * row];
+        }
+
+        std::vector<T> values(pattern.offsets[height]);
+        pattern.columnIndices.resize(pattern.offsets[height]);
+        SparseRowWiseMatrixView::runOnRowBlocks(height, thread_num, [this, colBeg, &ranges, &pattern, &values] (unsigned int row) {
+            auto target = pattern.offsets[row];
+            for (auto i = ranges[2 * row]; i < ranges[2 * row + 1]; i++, target++) {
+                values[target] = this->values[i];
+                pattern.columnIndices[target] = this->columnIndices[i] - colBeg;
+            }
+        });
+
+        return MatrixType(colEnd - colBeg, height, std::make_shared<const SparsityPattern>(std::move(pattern)), std::move(values));
+    }
+
+    MatrixType transposed() const {
+        std::vector<TripletType> triplets = {};
+        triplets.reserve(this->nonZeros());
+        for (unsigned int row = 0; row < this->height; row++) {
+            for (auto i = this->offsets[row]; i < this->offsets[row + 1]; i++) {
+                triplets.emplace_back(this->columnIndices[i], row, this->values[i]);
+            }
+        }
+
+        return MatrixType(this->height, this->width, std::move(triplets), false, true);
+    }
+
+    template<Semiring<T> S = PlusTimes<T>>
+    MatrixType multiplyRowWise(
+        const SparseRowWiseMatrixView& other,
+        const unsigned int initialQueueCapacity,
+        const unsigned int thread_num,
+        const Pruning<T>& pruning = {}
+    ) const {
+        std::vector<std::vector<TripletType>> vectorOfTriplets(this->height);
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        std::atomic<unsigned int> counter(0);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back(
+                [this, &other, initialQueueCapacity, &pruning, &counter, &vectorOfTriplets] () {
+                    while (true) {
+                        unsigned int row_l = counter++;
+                        if (row_l >= this->height) {
+                            break;
+                        }
+
+                        auto beg = this->offsets[row_l];
+                        MatrixType::template multiplyRowRowWise<S>(
+                            row_l,
+                            this->values.data() + beg,
+                            this->columnIndices.data() + beg,
+                            this->offsets[row_l + 1] - beg,
+                            other,
+                            initialQueueCapacity,
+                            vectorOfTriplets[row_l],
+                            pruning
+                        );
+                    }
+                }
+            );
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        return MatrixType(other.width, this->height, std::move(vectorOfTriplets));
+    }
+
+private:
+    template<typename F>
+    static void runOnRowBlocks(
+        unsigned int height,
+        unsigned int thread_num,
+        F f
+    ) {
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([height, thread_num, t, &f] () {
+                unsigned int rowBeg = static_cast<unsigned long long>(height) * t / thread_num;
+                unsigned int rowEnd = static_cast<unsigned long long>(height) * (t + 1) / thread_num;
+                for (auto row = rowBeg; row < rowEnd; row++) {
+                    f(row);
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+};
+}
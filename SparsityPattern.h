@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace Barta {
+
+// Structure of a row-wise sparse matrix (positions of the nonzeros without their values).
+// Matrices with the same structure share one immutable instance of it.
+struct SparsityPattern {
+    std::vector<unsigned int> columnIndices;
+    std::vector<unsigned int> offsets;
+
+    SparsityPattern() noexcept = default;
+    explicit SparsityPattern(
+        unsigned int height
+    ):
+        offsets(height + 1, 0) {}
+
+    size_t nonZeros() const { return this->columnIndices.size(); }
+
+    // boundaries of parts contiguous row blocks with roughly the same number of nonzeros
+    std::vector<unsigned int> balancedRowBlocks(
+        unsigned int parts
+    ) const {
+        unsigned int height = this->offsets.size() - 1;
+        std::vector<unsigned int> rowBlocks(parts + 1, height);
+        rowBlocks[0] = 0;
+        for (unsigned int p = 1; p < parts; p++) {
+            auto target = static_cast<unsigned long long>(this->nonZeros()) * p / parts;
+            auto row = std::lower_bound(this->offsets.begin(), this->offsets.end() - 1, target) - this->offsets.begin();
+            rowBlocks[p] = std::max<unsigned int>(rowBlocks[p - 1], row);
+        }
+
+        return rowBlocks;
+    }
+
+    bool operator==(const SparsityPattern& other) const = default;
+};
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "NumericTypeConcept.h"
+#include "SparseRowWiseMatrix.h"
+#include "Triplet.h"
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+namespace Barta {
+
+// Symmetric square matrix storing only the diagonal and the upper triangle.
+template<NumericType T>
+class SymmetricSparseRowWiseMatrix {
+public:
+    using VectorType = std::vector<T>;
+    using TripletType = Triplet<T>;
+    using GeneralType = SparseRowWiseMatrix<T>;
+
+    unsigned int size;
+    GeneralType upper;
+
+    // each off-diagonal pair is given once, in either triangle (e.g. the lower triangle of a Matrix Market file)
+    SymmetricSparseRowWiseMatrix(
+        unsigned int size,
+        std::vector<TripletType> triplets
+    ):
+        size(size),
+        upper(size, size, SymmetricSparseRowWiseMatrix::mirrorToUpper(std::move(triplets))) {}
+
+    static SymmetricSparseRowWiseMatrix fromGeneral(
+        const GeneralType& general
+    ) {
+        assert(general.width == general.height);
+
+        const auto& offsets = general.getOffsets();
+        const auto& columnIndices = general.getColumnIndices();
+        std::vector<TripletType> triplets;
+        triplets.reserve(general.values.size() / 2 + general.height);
+        for (unsigned int row = 0; row < general.height; row++) {
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                if (columnIndices[i] >= row) {
+                    triplets.emplace_back(row, columnIndices[i], general.values[i]);
+                }
+            }
+        }
+
+        return SymmetricSparseRowWiseMatrix(general.height, GeneralType(general.width, general.height, std::move(triplets), true, true));
+    }
+
+    GeneralType toGeneral() const {
+        const auto& offsets = this->upper.getOffsets();
+        const auto& columnIndices = this->upper.getColumnIndices();
+        std::vector<TripletType> triplets;
+        triplets.reserve(2 * this->upper.values.size());
+        for (unsigned int row = 0; row < this->size; row++) {
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                triplets.emplace_back(row, columnIndices[i], this->upper.values[i]);
+                if (columnIndices[i] != row) {
+                    triplets.emplace_back(columnIndices[i], row, this->upper.values[i]);
+                }
+            }
+        }
+
+        return GeneralType(this->size, this->size, std::move(triplets), false, true);
+    }
+
+    VectorType operator*(
+        const VectorType& v
+    ) const {
+        assert(this->size == v.size());
+
+        auto ret = VectorType(v.size(), static_cast<T>(0));
+        this->multiplyRows(v, 0, this->size, ret.data(), 0);
+
+        return ret;
+    }
+
+    // Every thread multiplies a block of rows into its own partial vector. Rows from rowBeg on only
+    // write to indices >= rowBeg, so the partial vectors cover [rowBeg, size) and are summed afterwards.
+    VectorType multiply(
+        const VectorType& v,
+        unsigned int thread_num
+    ) const {
+        assert(this->size == v.size());
+
+        if (thread_num <= 1) {
+            return *this * v;
+        }
+
+        auto rowBlocks = this->upper.getPattern()->balancedRowBlocks(thread_num);
+
+        std::vector<VectorType> partials(thread_num);
+        std::vector<std::thread> threads;
+        threads.reserve(thread_num);
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([this, &v, &rowBlocks, &partials, t] () {
+                auto rowBeg = rowBlocks[t];
+                partials[t].assign(this->size - rowBeg, static_cast<T>(0));
+                this->multiplyRows(v, rowBeg, rowBlocks[t + 1], partials[t].data(), rowBeg);
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        threads.clear();
+        auto ret = VectorType(v.size(), static_cast<T>(0));
+        for (unsigned int t = 0; t < thread_num; t++) {
+            threads.emplace_back([this, &rowBlocks, &partials, &ret, t, thread_num] () {
+                unsigned int beg = static_cast<unsigned long long>(this->size) * t / thread_num;
+                unsigned int end = static_cast<unsigned long long>(this->size) * (t + 1) / thread_num;
+                for (unsigned int p = 0; p < thread_num; p++) {
+                    auto rowBeg = rowBlocks[p];
+                    for (auto i = std::max(beg, rowBeg); i < end; i++) {
+                        ret[i] += partials[p][i - rowBeg];
+                    }
+                }
+            });
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        return ret;
+    }
+
+private:
+    SymmetricSparseRowWiseMatrix(
+        unsigned int size,
+        GeneralType upper
+    ):
+        size(size),
+        upper(std::move(upper)) {}
+
+    static std::vector<TripletType> mirrorToUpper(
+        std::vector<TripletType> triplets
+    ) {
+        for (auto& triplet: triplets) {
+            if (triplet.row > triplet.col) {
+                std::swap(triplet.row, triplet.col);
+            }
+        }
+
+        return triplets;
+    }
+
+    // ret[0] corresponds to the row retBeg
+    void multiplyRows(
+        const VectorType& v,
+        unsigned int rowBeg,
+        unsigned int rowEnd,
+        T* ret,
+        unsigned int retBeg
+    ) const {
+        const auto& offsets = this->upper.getOffsets();
+        const auto& columnIndices = this->upper.getColumnIndices();
+        const auto& values = this->upper.values;
+        for (auto row = rowBeg; row < rowEnd; row++) {
+            T sum = static_cast<T>(0);
+            auto v_row = v[row];
+            for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+                auto col = columnIndices[i];
+                sum += values[i] * v[col];
+                if (col != row) {
+                    ret[col - retBeg] += values[i] * v_row;
+                }
+            }
+
+            ret[row - retBeg] += sum;
+        }
+    }
+};
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 namespace Barta {
 template<typename T>
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Barta {
+
+// Storage format of matrix values narrower than the arithmetic type. encode() rounds a float to the stored code,
+// decode() converts n codes back to floats (the hot loop of the kernels, vectorized when the target allows it).
+// A scaled format stores codes relative to a per-row scale: encode() takes value / scale and the kernels
+// multiply the row result by the scale.
+template<typename F>
+concept ValueFormat = requires(float value, const typename F::StoredType* in, unsigned int n, float* out) {
+    { F::encode(value) } -> std::same_as<typename F::StoredType>;
+    F::decode(in, n, out);
+    { F::isScaled } -> std::convertible_to<bool>;
+    { F::maxCode } -> std::convertible_to<float>;
+};
+
+// IEEE 754 binary16: 5 exponent bits, 10 mantissa bits
+struct Float16Format {
+    using StoredType = std::uint16_t;
+
+    static constexpr bool isScaled = false;
+    static constexpr float maxCode = 65504.f;
+
+    // round to nearest even
+    static StoredType encode(
+        float value
+    ) {
+#ifdef __F16C__
+        return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+        return Float16Format::encodeSoftware(value);
+#endif
+    }
+
+    // encode() for targets without F16C; compiled everywhere so it can be checked against the instruction
+    static StoredType encodeSoftware(
+        float value
+    ) {
+        auto bits = std::bit_cast<std::uint32_t>(value);
+        StoredType sign = (bits >> 16) & 0x8000;
+        std::uint32_t magnitude = bits & 0x7FFFFFFF;
+        if (magnitude >= 0x7F800000) { // infinity, NaN
+            return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+        }
+
+        if (magnitude >= 0x477FF000) { // rounds above the largest half
+            return sign | 0x7C00;
+        }
+
+        if (magnitude < 0x38800000) { // below 2^-14, a subnormal half in units of 2^-24
+            return sign | static_cast<StoredType>(std::nearbyint(std::bit_cast<float>(magnitude) * 0x1p24f));
+        }
+
+        magnitude -= 112u << 23; // exponent bias 127 -> 15
+        magnitude += 0xFFF + ((magnitude >> 13) & 1);
+
+        return sign | static_cast<StoredType>(magnitude >> 13);
+    }
+
+    static float decode(
+        StoredType code
+    ) {
+        std::uint32_t sign = static_cast<std::uint32_t>(code & 0x8000) << 16;
+        std::uint32_t exponent = (code >> 10) & 0x1F;
+        std::uint32_t mantissa = code & 0x3FF;
+        if (exponent == 0) {
+            float value = mantissa * 0x1p-24f;
+
+            return sign ? -value : value;
+        }
+
+        if (exponent == 0x1F) {
+            return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+        }
+
+        return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+
+    static void decode(
+        const StoredType* in,
+        unsigned int n,
+        float* out
+    ) {
+        unsigned int i = 0;
+#ifdef __F16C__
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = Float16Format::decode(in[i]);
+        }
+    }
+};
+
+// upper half of a float: the float exponent range with 7 mantissa bits
+struct BFloat16Format {
+    using StoredType = std::uint16_t;
+
+    static constexpr bool isScaled = false;
+    static constexpr float maxCode = 3.38953139e38f;
+
+    // round to nearest even
+    static StoredType encode(
+        float value
+    ) {
+        auto bits = std::bit_cast<std::uint32_t>(value);
+        if ((bits & 0x7FFFFFFF) > 0x7F800000) { // keep NaN a quiet NaN
+            return (bits >> 16) | 0x40;
+        }
+
+        bits += 0x7FFF + ((bits >> 16) & 1);
+
+        return bits >> 16;
+    }
+
+    static float decode(
+        StoredType code
+    ) {
+        return std::bit_cast<float>(static_cast<std::uint32_t>(code) << 16);
+    }
+
+    static void decode(
+        const StoredType* in,
+        unsigned int n,
+        float* out
+    ) {
+        unsigned int i = 0;
+#ifdef __AVX2__
+        for (; i + 8 <= n; i += 8) {
+            auto widened = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+            _mm256_storeu_ps(out + i, _mm256_castsi256_ps(_mm256_slli_epi32(widened, 16)));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = BFloat16Format::decode(in[i]);
+        }
+    }
+};
+
+// symmetric 8-bit integers scaled per row, so the largest magnitude of a row maps to 127
+struct ScaledInt8Format {
+    using StoredType = std::int8_t;
+
+    static constexpr bool isScaled = true;
+    static constexpr float maxCode = 127.f;
+
+    static StoredType encode(
+        float value
+    ) {
+        return static_cast<StoredType>(std::clamp(std::nearbyint(value), -maxCode, maxCode));
+    }
+
+    static void decode(
+        const StoredType* in,
+        unsigned int n,
+        float* out
+    ) {
+        unsigned int i = 0;
+#ifdef __AVX2__
+        for (; i + 8 <= n; i += 8) {
+            auto widened = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+            _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(widened));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = in[i];
+        }
+    }
+};
+}